@@ -0,0 +1,366 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_mixer.h>
+#include "asset.h"
+#include "atlas.h"
+#include "loader.h"
+#include "pack.h"
+#include "profile.h"
+#include "utils.h"
+
+typedef enum {
+    ASSET_TEXTURE,
+    ASSET_SOUND,
+    ASSET_ATLAS,
+} asset_kind_type;
+
+typedef struct asset {
+    asset_kind_type  kind;
+    SDL_Renderer    *renderer;  // NULL for sounds.
+    char            *key;       // The filename, or for atlases every filename, one per line.
+    void            *data;      // Set on the main thread once loaded.
+    unsigned int     refs;      // Assets with no references stay cached until purged.
+    bool             loading;
+    struct asset    *next;
+
+    // Used while loading. Between submitting the job and its upload, only
+    // the loader thread touches these.
+    const char     **filenames; // Atlases only: the lines of key, split up.
+    char            *names;
+    size_t           count;
+    void            *decoded;
+} asset_type;
+
+static asset_type *asset_cache = NULL;
+
+
+static asset_type *
+asset_find(asset_kind_type  kind,
+           SDL_Renderer    *renderer,
+           const char      *key)
+{
+    asset_type *asset;
+
+    for (asset = asset_cache; asset != NULL; asset = asset->next) {
+        if (asset->kind == kind && asset->renderer == renderer && strcmp(asset->key, key) == 0) {
+            asset->refs++;
+            return asset;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Runs on a loader thread.
+ */
+static void
+asset_decode(asset_type *asset)
+{
+    PROFILE_BEGIN(decode, "asset.decode");
+
+    switch (asset->kind) {
+    case ASSET_TEXTURE:
+        asset->decoded = pack_load_surface(asset->key);
+        break;
+
+    case ASSET_SOUND:
+        asset->decoded = pack_load_sound(asset->key);
+        break;
+
+    case ASSET_ATLAS:
+        asset->decoded = atlas_decode(asset->filenames, asset->count);
+        break;
+    }
+
+    PROFILE_END(decode);
+}
+
+
+static void
+asset_upload(asset_type *asset)
+{
+    SDL_Texture *texture = NULL;
+    PROFILE_BEGIN(upload, "asset.upload");
+
+    switch (asset->kind) {
+    case ASSET_TEXTURE:
+        if (asset->decoded != NULL) {
+            texture = SDL_CreateTextureFromSurface(asset->renderer, asset->decoded);
+            if (texture != NULL) {
+                SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+            }
+            SDL_FreeSurface(asset->decoded);
+        }
+        asset->data = texture;
+        break;
+
+    case ASSET_SOUND:
+        asset->data = asset->decoded;
+        break;
+
+    case ASSET_ATLAS:
+        if (asset->decoded != NULL && !atlas_upload(asset->decoded, asset->renderer)) {
+            atlas_destroy(asset->decoded);
+            asset->decoded = NULL;
+        }
+        asset->data = asset->decoded;
+        free(asset->filenames);
+        free(asset->names);
+        asset->filenames = NULL;
+        asset->names = NULL;
+        break;
+    }
+
+    asset->decoded = NULL;
+    asset->loading = false;
+
+    PROFILE_END(upload);
+}
+
+
+/*
+ * Add an asset to the cache, with one reference, ready to be loaded. Takes
+ * ownership of key.
+ */
+static asset_type *
+asset_add(asset_kind_type  kind,
+          SDL_Renderer    *renderer,
+          char            *key)
+{
+    asset_type *asset;
+
+    asset = calloc(1, sizeof(*asset));
+    if (asset == NULL) {
+        free(key);
+        return NULL;
+    }
+
+    asset->key = key;
+    asset->kind = kind;
+    asset->renderer = renderer;
+    asset->refs = 1;
+    asset->loading = true;
+    asset->next = asset_cache;
+    asset_cache = asset;
+
+    return asset;
+}
+
+
+static char *
+asset_copy_string(const char *string)
+{
+    char *copy = malloc(strlen(string) + 1);
+
+    if (copy != NULL) {
+        strcpy(copy, string);
+    }
+
+    return copy;
+}
+
+
+/*
+ * See asset.h for details.
+ */
+asset_handle
+asset_texture_acquire(SDL_Renderer *renderer,
+                      const char   *filename)
+{
+    asset_type *asset;
+    char       *key;
+
+    asset = asset_find(ASSET_TEXTURE, renderer, filename);
+    if (asset == NULL) {
+        key = asset_copy_string(filename);
+        asset = key != NULL ? asset_add(ASSET_TEXTURE, renderer, key) : NULL;
+        if (asset != NULL) {
+            loader_submit((loader_fn_type)&asset_decode, (loader_fn_type)&asset_upload, asset);
+        }
+    }
+
+    return asset;
+}
+
+
+/*
+ * See asset.h for details.
+ */
+asset_handle
+asset_sound_acquire(const char *filename)
+{
+    asset_type *asset;
+    char       *key;
+
+    asset = asset_find(ASSET_SOUND, NULL, filename);
+    if (asset == NULL) {
+        key = asset_copy_string(filename);
+        asset = key != NULL ? asset_add(ASSET_SOUND, NULL, key) : NULL;
+        if (asset != NULL) {
+            loader_submit((loader_fn_type)&asset_decode, (loader_fn_type)&asset_upload, asset);
+        }
+    }
+
+    return asset;
+}
+
+
+/*
+ * See asset.h for details.
+ */
+asset_handle
+asset_atlas_acquire(SDL_Renderer      *renderer,
+                    const char *const *filenames,
+                    size_t             count)
+{
+    asset_type *asset;
+    char       *key;
+    char       *name;
+    size_t      key_length = 1;
+    size_t      i;
+
+    for (i = 0; i < count; i++) {
+        key_length += strlen(filenames[i]) + 1;
+    }
+
+    key = malloc(key_length);
+    if (key == NULL) {
+        return NULL;
+    }
+
+    key[0] = '\0';
+    for (i = 0; i < count; i++) {
+        strcat(key, filenames[i]);
+        strcat(key, "\n");
+    }
+
+    asset = asset_find(ASSET_ATLAS, renderer, key);
+    if (asset != NULL) {
+        free(key);
+        return asset;
+    }
+
+    asset = asset_add(ASSET_ATLAS, renderer, key);
+    if (asset == NULL) {
+        return NULL;
+    }
+
+    // Give the loader its own copy of the filenames, as the caller's may not
+    // last.
+    asset->names = asset_copy_string(key);
+    asset->filenames = calloc(count > 0 ? count : 1, sizeof(*asset->filenames));
+    if (asset->names == NULL || asset->filenames == NULL) {
+        // It was added at the head of the cache, and nothing else has seen
+        // it yet.
+        asset_cache = asset->next;
+        free(asset->filenames);
+        free(asset->names);
+        free(asset->key);
+        free(asset);
+        return NULL;
+    }
+
+    asset->count = count;
+    for (i = 0, name = asset->names; i < count; i++) {
+        asset->filenames[i] = name;
+        name = strchr(name, '\n');
+        *name++ = '\0';
+    }
+
+    loader_submit((loader_fn_type)&asset_decode, (loader_fn_type)&asset_upload, asset);
+
+    return asset;
+}
+
+
+/*
+ * See asset.h for details.
+ */
+void
+asset_release(asset_handle asset)
+{
+    if (asset != NULL && asset->refs > 0) {
+        asset->refs--;
+    }
+}
+
+
+/*
+ * See asset.h for details.
+ */
+SDL_Texture *
+asset_texture(asset_handle asset)
+{
+    return asset != NULL && asset->kind == ASSET_TEXTURE ? asset->data : NULL;
+}
+
+
+/*
+ * See asset.h for details.
+ */
+Mix_Chunk *
+asset_sound(asset_handle asset)
+{
+    return asset != NULL && asset->kind == ASSET_SOUND ? asset->data : NULL;
+}
+
+
+/*
+ * See asset.h for details.
+ */
+atlas_handle
+asset_atlas(asset_handle asset)
+{
+    return asset != NULL && asset->kind == ASSET_ATLAS ? asset->data : NULL;
+}
+
+
+static void
+asset_free(asset_type *asset)
+{
+    if (asset->data != NULL) {
+        switch (asset->kind) {
+        case ASSET_TEXTURE:
+            free_texture(asset->data);
+            break;
+
+        case ASSET_SOUND:
+            Mix_FreeChunk(asset->data);
+            break;
+
+        case ASSET_ATLAS:
+            atlas_destroy(asset->data);
+            break;
+        }
+    }
+
+    free(asset->filenames);
+    free(asset->names);
+    free(asset->key);
+    free(asset);
+}
+
+
+/*
+ * See asset.h for details.
+ */
+void
+asset_cache_purge(void)
+{
+    asset_type **link = &asset_cache;
+    asset_type  *asset;
+
+    while (*link != NULL) {
+        asset = *link;
+        if (asset->refs == 0 && !asset->loading) {
+            *link = asset->next;
+            asset_free(asset);
+        } else {
+            link = &asset->next;
+        }
+    }
+}
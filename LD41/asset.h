@@ -0,0 +1,52 @@
+#ifndef __ASSET_H__
+#define __ASSET_H__
+
+
+/*
+ * Loaded textures, sounds and sprite atlases, shared and reference counted.
+ * Acquiring an asset that is already loaded takes another reference to it,
+ * and released assets stay resident until asset_cache_purge, so a state that
+ * is torn down and set up again (e.g. the game on every restart) loads
+ * nothing the second time. Only call these from the main thread.
+ *
+ * New assets are loaded through the loader (see loader.h), so while it is
+ * running they arrive a few frames after they're acquired. Until then, and
+ * for good if loading fails, asset_texture and friends return NULL.
+ */
+
+#include <stddef.h>
+#include <SDL.h>
+#include <SDL_mixer.h>
+
+#include "atlas.h"
+
+typedef struct asset *asset_handle;
+
+
+/*
+ * Each of these returns NULL only if memory runs out. Releasing NULL does
+ * nothing.
+ */
+asset_handle asset_texture_acquire(SDL_Renderer *renderer, const char *filename);
+asset_handle asset_sound_acquire(const char *filename);
+
+/*
+ * An atlas is shared by anything asking for the same images in the same
+ * order. See atlas_create.
+ */
+asset_handle asset_atlas_acquire(SDL_Renderer *renderer, const char *const *filenames, size_t count);
+
+void asset_release(asset_handle asset);
+
+SDL_Texture *asset_texture(asset_handle asset);
+Mix_Chunk *asset_sound(asset_handle asset);
+atlas_handle asset_atlas(asset_handle asset);
+
+/*
+ * Free every cached asset that nothing holds a reference to and isn't still
+ * loading.
+ */
+void asset_cache_purge(void);
+
+
+#endif /* __ASSET_H__ */
@@ -0,0 +1,193 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <SDL.h>
+#include "atlas.h"
+#include "batch.h"
+#include "pack.h"
+#include "shelf.h"
+#include "utils.h"
+
+// Space left around each sprite, so filtering doesn't bleed in neighbours.
+#define ATLAS_PADDING 1
+
+typedef struct atlas {
+    SDL_Texture *texture;
+    SDL_Surface *surface;      // The packed images, until they're uploaded.
+    int          width;
+    int          height;
+    SDL_Rect    *sprites;
+    size_t       sprite_count;
+    batch_type   batch;
+} atlas_type;
+
+
+/*
+ * Lay the sprites out and work out how big the texture needs to be. Sprites
+ * that failed to load take no space.
+ */
+static bool
+atlas_pack(atlas_type   *atlas,
+           SDL_Surface **surfaces)
+{
+    size_t i;
+
+    for (i = 0; i < atlas->sprite_count; i++) {
+        atlas->sprites[i].w = surfaces[i] != NULL ? surfaces[i]->w : 0;
+        atlas->sprites[i].h = surfaces[i] != NULL ? surfaces[i]->h : 0;
+    }
+
+    return shelf_pack(atlas->sprites, atlas->sprite_count, ATLAS_PADDING, &atlas->width, &atlas->height);
+}
+
+
+/*
+ * See atlas.h for details.
+ */
+atlas_handle
+atlas_decode(const char *const *filenames,
+             size_t             count)
+{
+    atlas_handle  result = NULL;
+    SDL_Surface **surfaces = NULL;
+    size_t        i;
+    bool          ok = true;
+
+    if (ok) {
+        result = calloc(1, sizeof(*result));
+        surfaces = calloc(count, sizeof(*surfaces));
+        if (result == NULL || surfaces == NULL) {
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        result->sprites = calloc(count, sizeof(*result->sprites));
+        result->sprite_count = count;
+        if (result->sprites == NULL) {
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        for (i = 0; i < count; i++) {
+            surfaces[i] = pack_load_surface(filenames[i]);
+            if (surfaces[i] == NULL) {
+                SDL_Log("Failed to load %s: %s", filenames[i], SDL_GetError());
+            }
+        }
+
+        ok = atlas_pack(result, surfaces);
+    }
+
+    if (ok) {
+        result->surface = SDL_CreateRGBSurfaceWithFormat(0, result->width, result->height, 32, SDL_PIXELFORMAT_RGBA32);
+        if (result->surface == NULL) {
+            SDL_Log("SDL_CreateRGBSurfaceWithFormat() failed: %s", SDL_GetError());
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        // Copy each image in as it is, alpha and all, rather than blending.
+        for (i = 0; i < count; i++) {
+            if (surfaces[i] != NULL) {
+                (void)SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+                (void)SDL_BlitSurface(surfaces[i], NULL, result->surface, &result->sprites[i]);
+            }
+        }
+    }
+
+    for (i = 0; surfaces != NULL && i < count; i++) {
+        SDL_FreeSurface(surfaces[i]);
+    }
+    free(surfaces);
+    if (!ok && result != NULL) {
+        atlas_destroy(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+
+/*
+ * See atlas.h for details.
+ */
+bool
+atlas_upload(atlas_handle  atlas,
+             SDL_Renderer *renderer)
+{
+    if (atlas->texture == NULL && atlas->surface != NULL) {
+        atlas->texture = SDL_CreateTextureFromSurface(renderer, atlas->surface);
+        if (atlas->texture != NULL) {
+            SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+            batch_init(&atlas->batch, atlas->texture);
+            SDL_FreeSurface(atlas->surface);
+            atlas->surface = NULL;
+        }
+    }
+
+    return atlas->texture != NULL;
+}
+
+
+/*
+ * See atlas.h for details.
+ */
+atlas_handle
+atlas_create(SDL_Renderer      *renderer,
+             const char *const *filenames,
+             size_t             count)
+{
+    atlas_handle result;
+
+    result = atlas_decode(filenames, count);
+    if (result != NULL && !atlas_upload(result, renderer)) {
+        atlas_destroy(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+
+/*
+ * See atlas.h for details.
+ */
+void
+atlas_destroy(atlas_handle atlas)
+{
+    batch_destroy(&atlas->batch);
+    SDL_FreeSurface(atlas->surface);
+    if (atlas->texture != NULL) {
+        SDL_DestroyTexture(atlas->texture);
+    }
+    free(atlas->sprites);
+    free(atlas);
+}
+
+
+/*
+ * See atlas.h for details.
+ */
+void
+atlas_draw(atlas_handle    atlas,
+           size_t          sprite,
+           const SDL_Rect *dest)
+{
+    if (atlas->texture != NULL && sprite < atlas->sprite_count && atlas->sprites[sprite].w > 0 &&
+        dest->w > 0 && dest->h > 0) {
+        (void)batch_add(&atlas->batch, &atlas->sprites[sprite], dest, color_white);
+    }
+}
+
+
+/*
+ * See atlas.h for details.
+ */
+void
+atlas_flush(atlas_handle  atlas,
+            SDL_Renderer *renderer)
+{
+    batch_flush(&atlas->batch, renderer);
+}
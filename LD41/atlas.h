@@ -0,0 +1,53 @@
+#ifndef __ATLAS_H__
+#define __ATLAS_H__
+
+
+/*
+ * A set of sprites packed into one texture at load time, with a batch (see
+ * batch.h) that queues up copies of them and submits the lot together, so a
+ * frame full of sprites costs one draw call and no texture switches.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL.h>
+
+typedef struct atlas *atlas_handle;
+
+
+/*
+ * Load and pack the images, in order, so that sprite i is filenames[i].
+ * Images that fail to load become empty sprites, which draw nothing. Returns
+ * NULL if the atlas itself can't be built.
+ */
+atlas_handle atlas_create(SDL_Renderer      *renderer,
+                          const char *const *filenames,
+                          size_t             count);
+void atlas_destroy(atlas_handle atlas);
+
+/*
+ * atlas_create in two steps, so that the images can be loaded and packed
+ * without a renderer, e.g. on a loader thread. The atlas can't be drawn until
+ * it has been uploaded. atlas_upload returns false if creating the texture
+ * fails.
+ */
+atlas_handle atlas_decode(const char *const *filenames,
+                          size_t             count);
+bool atlas_upload(atlas_handle  atlas,
+                  SDL_Renderer *renderer);
+
+/*
+ * Queue a copy of a whole sprite, scaled to fill dest.
+ */
+void atlas_draw(atlas_handle    atlas,
+                size_t          sprite,
+                const SDL_Rect *dest);
+
+/*
+ * Submit everything queued since the last flush, then empty the batch.
+ */
+void atlas_flush(atlas_handle  atlas,
+                 SDL_Renderer *renderer);
+
+
+#endif /* __ATLAS_H__ */
@@ -0,0 +1,258 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include "batch.h"
+#include "utils.h"
+
+#define BATCH_INITIAL_SIZE 256
+
+
+/*
+ * See batch.h for details.
+ */
+void
+batch_init(batch_type  *batch,
+           SDL_Texture *texture)
+{
+    batch->texture = texture;
+    batch->texture_width = 1;
+    batch->texture_height = 1;
+    batch->quads = NULL;
+    batch->count = 0;
+    batch->size = 0;
+#if BATCH_GEOMETRY
+    batch->vertices = NULL;
+    batch->indices = NULL;
+#endif
+
+    if (texture != NULL) {
+        (void)SDL_QueryTexture(texture, NULL, NULL, &batch->texture_width, &batch->texture_height);
+    }
+}
+
+
+/*
+ * See batch.h for details.
+ */
+void
+batch_destroy(batch_type *batch)
+{
+#if BATCH_GEOMETRY
+    free(batch->indices);
+    free(batch->vertices);
+    batch->vertices = NULL;
+    batch->indices = NULL;
+#endif
+    free(batch->quads);
+    batch->quads = NULL;
+    batch->count = 0;
+    batch->size = 0;
+}
+
+
+static bool
+batch_grow(batch_type *batch)
+{
+    batch_quad_type *quads;
+    size_t           size;
+#if BATCH_GEOMETRY
+    SDL_Vertex      *vertices;
+    int             *indices;
+    size_t           i;
+#endif
+
+    size = batch->size == 0 ? BATCH_INITIAL_SIZE : batch->size * 2;
+
+    quads = realloc(batch->quads, size * sizeof(*quads));
+    if (quads == NULL) {
+        return false;
+    }
+    batch->quads = quads;
+
+#if BATCH_GEOMETRY
+    vertices = realloc(batch->vertices, size * 4 * sizeof(*vertices));
+    if (vertices == NULL) {
+        return false;
+    }
+    batch->vertices = vertices;
+
+    indices = realloc(batch->indices, size * 6 * sizeof(*indices));
+    if (indices == NULL) {
+        return false;
+    }
+    batch->indices = indices;
+
+    // Each quad is two triangles over its four corners, so the indices only
+    // need writing when the batch grows.
+    for (i = batch->size; i < size; i++) {
+        indices[i * 6 + 0] = (int)(i * 4 + 0);
+        indices[i * 6 + 1] = (int)(i * 4 + 1);
+        indices[i * 6 + 2] = (int)(i * 4 + 2);
+        indices[i * 6 + 3] = (int)(i * 4 + 2);
+        indices[i * 6 + 4] = (int)(i * 4 + 3);
+        indices[i * 6 + 5] = (int)(i * 4 + 0);
+    }
+#endif
+
+    batch->size = size;
+
+    return true;
+}
+
+
+/*
+ * See batch.h for details.
+ */
+batch_quad_type *
+batch_add(batch_type     *batch,
+          const SDL_Rect *src,
+          const SDL_Rect *dest,
+          SDL_Color       color)
+{
+    batch_quad_type *quad;
+
+    if (batch->count == batch->size && !batch_grow(batch)) {
+        return NULL;
+    }
+
+    quad = &batch->quads[batch->count++];
+    quad->src = *src;
+    quad->dest = *dest;
+    quad->color = color;
+    quad->angle = 0.0f;
+    quad->origin.x = 0;
+    quad->origin.y = 0;
+
+    return quad;
+}
+
+
+/*
+ * See batch.h for details.
+ */
+bool
+batch_append(batch_type            *batch,
+             const batch_quad_type *quads,
+             size_t                 count)
+{
+    while (batch->size - batch->count < count) {
+        if (!batch_grow(batch)) {
+            return false;
+        }
+    }
+
+    memcpy(&batch->quads[batch->count], quads, count * sizeof(*quads));
+    batch->count += count;
+
+    return true;
+}
+
+
+#if BATCH_GEOMETRY
+static inline void
+batch_set_vertex(SDL_Vertex       *vertex,
+                 const batch_type *batch,
+                 float             x,
+                 float             y,
+                 int               u,
+                 int               v,
+                 SDL_Color         color)
+{
+    vertex->position.x = x;
+    vertex->position.y = y;
+    vertex->color = color;
+    vertex->tex_coord.x = (float)u / batch->texture_width;
+    vertex->tex_coord.y = (float)v / batch->texture_height;
+}
+
+
+static void
+batch_quad_vertices(const batch_type      *batch,
+                    const batch_quad_type *quad,
+                    SDL_Vertex            *vertices)
+{
+    const SDL_Rect *src = &quad->src;
+    const SDL_Rect *dest = &quad->dest;
+    float           xs[4] = { (float)dest->x, (float)(dest->x + dest->w), (float)(dest->x + dest->w), (float)dest->x };
+    float           ys[4] = { (float)dest->y, (float)dest->y, (float)(dest->y + dest->h), (float)(dest->y + dest->h) };
+    float           cos_angle;
+    float           sin_angle;
+    float           x;
+    float           y;
+    int             i;
+
+    if (quad->angle != 0.0f) {
+        cos_angle = cosf(quad->angle);
+        sin_angle = sinf(quad->angle);
+        for (i = 0; i < 4; i++) {
+            x = xs[i] - quad->origin.x;
+            y = ys[i] - quad->origin.y;
+            xs[i] = x * cos_angle - y * sin_angle + quad->origin.x;
+            ys[i] = x * sin_angle + y * cos_angle + quad->origin.y;
+        }
+    }
+
+    batch_set_vertex(&vertices[0], batch, xs[0], ys[0], src->x, src->y, quad->color);
+    batch_set_vertex(&vertices[1], batch, xs[1], ys[1], src->x + src->w, src->y, quad->color);
+    batch_set_vertex(&vertices[2], batch, xs[2], ys[2], src->x + src->w, src->y + src->h, quad->color);
+    batch_set_vertex(&vertices[3], batch, xs[3], ys[3], src->x, src->y + src->h, quad->color);
+}
+#endif
+
+
+/*
+ * See batch.h for details.
+ */
+void
+batch_flush(batch_type   *batch,
+            SDL_Renderer *renderer)
+{
+    size_t                 i;
+#if !BATCH_GEOMETRY
+    const batch_quad_type *quad;
+    SDL_Point              center;
+    SDL_Color              color = color_white;
+#endif
+
+    if (batch->count == 0 || batch->texture == NULL) {
+        batch->count = 0;
+        return;
+    }
+
+#if BATCH_GEOMETRY
+    for (i = 0; i < batch->count; i++) {
+        batch_quad_vertices(batch, &batch->quads[i], &batch->vertices[i * 4]);
+    }
+
+    (void)SDL_RenderGeometry(renderer, batch->texture, batch->vertices, (int)(batch->count * 4),
+                             batch->indices, (int)(batch->count * 6));
+#else
+    (void)SDL_SetTextureColorMod(batch->texture, color.r, color.g, color.b);
+    (void)SDL_SetTextureAlphaMod(batch->texture, color.a);
+
+    for (i = 0; i < batch->count; i++) {
+        quad = &batch->quads[i];
+
+        // Only touch the color mod when it changes.
+        if (quad->color.r != color.r || quad->color.g != color.g ||
+            quad->color.b != color.b || quad->color.a != color.a) {
+            color = quad->color;
+            (void)SDL_SetTextureColorMod(batch->texture, color.r, color.g, color.b);
+            (void)SDL_SetTextureAlphaMod(batch->texture, color.a);
+        }
+
+        if (quad->angle == 0.0f) {
+            (void)SDL_RenderCopy(renderer, batch->texture, &quad->src, &quad->dest);
+        } else {
+            center.x = quad->origin.x - quad->dest.x;
+            center.y = quad->origin.y - quad->dest.y;
+            (void)SDL_RenderCopyEx(renderer, batch->texture, &quad->src, &quad->dest,
+                                   RAD_TO_DEG(quad->angle), &center, SDL_FLIP_NONE);
+        }
+    }
+#endif
+
+    batch->count = 0;
+}
@@ -0,0 +1,69 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+
+/*
+ * Copies from one texture, queued up and submitted together. With SDL 2.0.18
+ * or later a flush is a single SDL_RenderGeometry call however many quads
+ * are queued; older SDLs fall back to a copy per quad, still without any
+ * texture switches.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL.h>
+
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define BATCH_GEOMETRY 1
+#else
+#define BATCH_GEOMETRY 0
+#endif
+
+typedef struct batch_quad {
+    SDL_Rect  src;
+    SDL_Rect  dest;
+    SDL_Color color;  // Multiplied with the texture, as with a color mod.
+    float     angle;  // Radians clockwise about origin. Most quads use 0, which is cheaper.
+    SDL_Point origin; // In window coordinates.
+} batch_quad_type;
+
+typedef struct batch {
+    SDL_Texture     *texture;
+    int              texture_width;
+    int              texture_height;
+    batch_quad_type *quads;          // Queued since the last flush, in drawing order.
+    size_t           count;
+    size_t           size;
+#if BATCH_GEOMETRY
+    SDL_Vertex      *vertices;       // Four per quad.
+    int             *indices;        // Six per quad, the same for every flush.
+#endif
+} batch_type;
+
+
+/*
+ * Start an empty batch drawing from texture, which the batch doesn't own.
+ */
+void batch_init(batch_type *batch, SDL_Texture *texture);
+void batch_destroy(batch_type *batch);
+
+/*
+ * Queue a quad, returning it so it can be adjusted until the next flush, or
+ * NULL if memory runs out.
+ */
+batch_quad_type *batch_add(batch_type *batch, const SDL_Rect *src, const SDL_Rect *dest, SDL_Color color);
+
+/*
+ * Queue a run of quads prepared earlier, e.g. a cached text layout. Returns
+ * false, queuing nothing, if memory runs out.
+ */
+bool batch_append(batch_type *batch, const batch_quad_type *quads, size_t count);
+
+/*
+ * Draw everything queued since the last flush, then empty the batch.
+ */
+void batch_flush(batch_type *batch, SDL_Renderer *renderer);
+
+
+#endif /* __BATCH_H__ */
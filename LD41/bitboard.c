@@ -0,0 +1,57 @@
+#include <stddef.h>
+#include "bitboard.h"
+
+// Every cell apart from those in the right-hand column.
+#define NOT_LAST_COLUMN 0x7F7F7F7F7F7F7F7FULL
+
+
+/*
+ * Given a mask of "pairs" - cells whose next neighbour along the line (stride
+ * bits further on) is also set - find the runs of 3 or more along the line.
+ */
+static inline bitboard_type
+bitboard_line_runs(bitboard_type pairs,
+                   unsigned int  stride,
+                   unsigned int *score)
+{
+    bitboard_type starts;
+    bitboard_type longer;
+    unsigned int  shift;
+
+    // A run of 3 starts wherever two pairs are next to each other.
+    starts = pairs & (pairs >> stride);
+    if (starts == 0) {
+        return 0;
+    }
+
+    // Each start is worth 2 for its first 3 cells, plus 1 for every further
+    // cell the run continues for.
+    *score += bitboard_count(starts) * 2;
+    for (shift = 2, longer = starts & (pairs >> (shift * stride));
+         longer != 0;
+         shift++, longer &= pairs >> (shift * stride)) {
+        *score += bitboard_count(longer);
+    }
+
+    return starts | (starts << stride) | (starts << (stride * 2));
+}
+
+
+/*
+ * See bitboard.h for details.
+ */
+bitboard_type
+bitboard_runs(bitboard_type mask, unsigned int *run_score)
+{
+    bitboard_type result;
+    unsigned int  score = 0;
+
+    result = bitboard_line_runs(mask & (mask >> 1) & NOT_LAST_COLUMN, 1, &score);
+    result |= bitboard_line_runs(mask & (mask >> BITBOARD_SIZE), BITBOARD_SIZE, &score);
+
+    if (run_score != NULL) {
+        *run_score = score;
+    }
+
+    return result;
+}
@@ -0,0 +1,83 @@
+#ifndef __BITBOARD_H__
+#define __BITBOARD_H__
+
+
+#include <stdint.h>
+
+
+/*
+ * An 8x8 board packed into a 64-bit mask, one bit per cell.
+ * Bit (y * BITBOARD_SIZE + x) holds the cell in column x, row y.
+ */
+#define BITBOARD_SIZE 8
+
+#define BITBOARD_CELL(x, y) ((bitboard_type)1 << ((y) * BITBOARD_SIZE + (x)))
+
+typedef uint64_t bitboard_type;
+
+
+static inline unsigned int
+bitboard_count(bitboard_type mask)
+{
+#if defined(__GNUC__)
+    return (unsigned int)__builtin_popcountll(mask);
+#else
+    mask = mask - ((mask >> 1) & 0x5555555555555555ULL);
+    mask = (mask & 0x3333333333333333ULL) + ((mask >> 2) & 0x3333333333333333ULL);
+    mask = (mask + (mask >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (unsigned int)((mask * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/*
+ * Find the index of the lowest set bit. The mask must not be empty.
+ */
+static inline unsigned int
+bitboard_first(bitboard_type mask)
+{
+#if defined(__GNUC__)
+    return (unsigned int)__builtin_ctzll(mask);
+#else
+    return bitboard_count((mask & (0 - mask)) - 1);
+#endif
+}
+
+/*
+ * Every cell in a row that has at least one set cell.
+ */
+static inline bitboard_type
+bitboard_rows(bitboard_type mask)
+{
+    // Fold each row's bits down into its first cell, then spread them back
+    // out along the row. No bits cross between rows on the way down.
+    mask |= mask >> 4;
+    mask |= mask >> 2;
+    mask |= mask >> 1;
+    return (mask & 0x0101010101010101ULL) * 0xFF;
+}
+
+/*
+ * Every cell in a column that has at least one set cell.
+ */
+static inline bitboard_type
+bitboard_columns(bitboard_type mask)
+{
+    mask |= mask >> 32;
+    mask |= mask >> 16;
+    mask |= mask >> 8;
+    return (mask & 0xFF) * 0x0101010101010101ULL;
+}
+
+/*
+ * Find every horizontal and vertical run of 3 or more set cells in a mask,
+ * returning a mask of the cells in those runs.
+ *
+ * If run_score is not NULL it is set to the sum, over every cell that starts
+ * a run of 3 or more reading right or down, of the number of cells remaining
+ * in the run minus one. That's the number of MATCH_ENERGY units the game
+ * awards for the runs.
+ */
+bitboard_type bitboard_runs(bitboard_type mask, unsigned int *run_score);
+
+
+#endif /* __BITBOARD_H__ */
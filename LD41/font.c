@@ -1,9 +1,16 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include "batch.h"
 #include "font.h"
+#include "loader.h"
+#include "pack.h"
+#include "platform.h"
+#include "profile.h"
+#include "shelf.h"
 #include "utils.h"
 
 #define MIN_CHAR 0x20
@@ -11,16 +18,191 @@
 #define CHAR_COUNT (MAX_CHAR - MIN_CHAR + 1)
 #define CHAR_INDEX(c) ((c) - MIN_CHAR)
 
+// Drawn in place of anything that isn't valid UTF-8.
+#define REPLACEMENT_CHAR 0xFFFD
+
+// Space left around each character in the texture, so filtering doesn't
+// bleed in neighbours.
+#define MAPPED_FONT_PADDING 1
+
+// Rasterized fonts are cached on disk, in the same format as the asset pack.
+// Bump the version whenever the way glyphs are laid out changes.
+#define MAPPED_FONT_DISK_VERSION 2
+#define MAPPED_FONT_DISK_ENTRY "glyphs"
+
+// Characters outside the base set are rasterized as they're first drawn,
+// onto extra pages of their own. Page 0 is always the base set, which is
+// pre-rasterized (and cached) as a whole.
+#define MAPPED_FONT_MAX_PAGES 8
+#define MAPPED_FONT_BASE_PAGE 0
+
+// Extra pages are square, wide enough for about this many characters a row.
+#define MAPPED_FONT_PAGE_CHARS_ACROSS 8
+#define MAPPED_FONT_PAGE_MIN_SIZE 256
+#define MAPPED_FONT_PAGE_MAX_SIZE 1024
+
+// Texture memory every font's extra pages may use between them. Past it, the
+// least recently drawn pages are evicted to make room. Pages with text queued
+// on them can't be, so a frame with a lot of different text may go over.
+#define MAPPED_FONT_PAGE_BUDGET (16 * 1024 * 1024)
+
+#define MAPPED_FONT_GLYPHS_MIN_SIZE 64
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+// A character rasterized onto an extra page.
+typedef struct mapped_glyph {
+    uint32_t codepoint; // 0 for an empty slot.
+    int      page;
+    SDL_Rect rect;      // Empty if the font has no glyph for it, so it isn't tried again.
+} mapped_glyph_type;
+
+typedef struct mapped_font_page {
+    SDL_Texture *texture;   // NULL for an unused page.
+    shelf_type   shelf;     // Room left on an extra page.
+    uint64_t     last_used; // mapped_font_clock when last drawn from.
+} mapped_font_page_type;
+
 typedef struct mapped_font {
-    SDL_Rect     map[CHAR_COUNT];
-    SDL_Texture *texture;
+    SDL_Rect               map[CHAR_COUNT];
+    SDL_Surface           *surface;   // The rasterized characters, until they're uploaded.
+    pack_file_type         disk_file; // The disk cache file surface points into, if any.
+    mapped_font_page_type  pages[MAPPED_FONT_MAX_PAGES]; // The base page's texture is NULL until loaded, and for good if loading fails.
+    batch_type             batches[MAPPED_FONT_MAX_PAGES]; // Text queued on each page since the last flush.
+
+    // Characters outside the base set
+    mapped_glyph_type     *glyphs;     // Open addressed by codepoint, glyph_size (a power of two) slots.
+    size_t                 glyph_size;
+    size_t                 glyph_count;
+    TTF_Font              *ttf;        // Opened the first time one is drawn.
+    bool                   ttf_failed;
+    int                    page_size;
+    unsigned int           generation; // Bumped when a page is evicted, so cached layouts know to redo.
+
+    // Cache entry
+    SDL_Renderer          *renderer;
+    char                  *filename;
+    int                    height;
+    unsigned int           refs;       // Fonts with no references stay cached until purged.
+    bool                   loading;
+    struct mapped_font    *next;
 } mapped_font_type;
 
+// Every font loaded, so each file and size is only rasterized once.
+static mapped_font_handle mapped_font_cache = NULL;
+static SDL_mutex         *mapped_font_ttf_lock = NULL;
+static char              *mapped_font_disk_path = NULL; // Where the disk cache lives, or NULL for no caching.
+
+// Ticks once per layout, to tell which extra pages were drawn from least
+// recently, and which are in use by the layout under way.
+static uint64_t           mapped_font_clock = 0;
+static size_t             mapped_font_page_bytes = 0;  // Used by every font's extra pages.
+
+typedef struct mapped_text {
+    mapped_font_handle      font;
+    int                     x;
+    int                     y;
+    SDL_Color               color;
+    mapped_font_align_type  align;
+    batch_type              layouts[MAPPED_FONT_MAX_PAGES]; // The glyphs on each of the font's pages, ready to copy into its batches. Never flushed themselves.
+    char                   *string; // Kept to lay out again if the font wasn't loaded the first time, or evicts a page.
+    bool                    laid_out;
+    unsigned int            generation;
+    uint64_t                key;
+    bool                    key_set;
+} mapped_text_type;
 
+
+/*
+ * Whether a character is drawn, rather than a control character.
+ */
 static inline bool
-mapped_font_char_ok(char c)
+mapped_font_char_ok(uint32_t codepoint)
 {
-    return c >= MIN_CHAR && c <= MAX_CHAR;
+    return (codepoint >= MIN_CHAR && codepoint <= MAX_CHAR) || codepoint >= 0xA0;
+}
+
+
+/*
+ * Decode the character at *text and step past it. Anything that isn't valid
+ * UTF-8 comes out as REPLACEMENT_CHAR, one byte at a time. Never reads past
+ * the terminator.
+ */
+static uint32_t
+mapped_font_utf8_next(const char **text)
+{
+    const unsigned char *bytes = (const unsigned char *)*text;
+    uint32_t             codepoint;
+    int                  extra;
+    int                  i;
+
+    if (bytes[0] < 0x80) {
+        codepoint = bytes[0];
+        extra = 0;
+    } else if ((bytes[0] & 0xE0) == 0xC0) {
+        codepoint = bytes[0] & 0x1F;
+        extra = 1;
+    } else if ((bytes[0] & 0xF0) == 0xE0) {
+        codepoint = bytes[0] & 0x0F;
+        extra = 2;
+    } else if ((bytes[0] & 0xF8) == 0xF0) {
+        codepoint = bytes[0] & 0x07;
+        extra = 3;
+    } else {
+        *text += 1;
+        return REPLACEMENT_CHAR;
+    }
+
+    for (i = 1; i <= extra; i++) {
+        if ((bytes[i] & 0xC0) != 0x80) {
+            *text += 1;
+            return REPLACEMENT_CHAR;
+        }
+        codepoint = (codepoint << 6) | (bytes[i] & 0x3F);
+    }
+    *text += extra + 1;
+
+    // Overlong encodings, surrogates and anything past the last plane.
+    if ((extra == 1 && codepoint < 0x80) ||
+        (extra == 2 && codepoint < 0x800) ||
+        (extra == 3 && codepoint < 0x10000) ||
+        (codepoint >= 0xD800 && codepoint <= 0xDFFF) ||
+        codepoint > 0x10FFFF) {
+        return REPLACEMENT_CHAR;
+    }
+
+    return codepoint;
+}
+
+
+/*
+ * Encode a character as UTF-8 into buf, which needs room for 5 bytes,
+ * terminating it.
+ */
+static void
+mapped_font_utf8_encode(uint32_t  codepoint,
+                        char     *buf)
+{
+    if (codepoint < 0x80) {
+        buf[0] = (char)codepoint;
+        buf[1] = '\0';
+    } else if (codepoint < 0x800) {
+        buf[0] = (char)(0xC0 | (codepoint >> 6));
+        buf[1] = (char)(0x80 | (codepoint & 0x3F));
+        buf[2] = '\0';
+    } else if (codepoint < 0x10000) {
+        buf[0] = (char)(0xE0 | (codepoint >> 12));
+        buf[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        buf[2] = (char)(0x80 | (codepoint & 0x3F));
+        buf[3] = '\0';
+    } else {
+        buf[0] = (char)(0xF0 | (codepoint >> 18));
+        buf[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+        buf[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        buf[3] = (char)(0x80 | (codepoint & 0x3F));
+        buf[4] = '\0';
+    }
 }
 
 
@@ -51,125 +233,414 @@ mapped_font_create_surface(int width,
                            int height)
 {
     SDL_Surface *surface;
-    Uint32       rmask;
-    Uint32       gmask;
-    Uint32       bmask;
-    Uint32       amask;
-
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-    rmask = 0xff000000;
-    gmask = 0x00ff0000;
-    bmask = 0x0000ff00;
-    amask = 0x000000ff;
-#else
-    rmask = 0x000000ff;
-    gmask = 0x0000ff00;
-    bmask = 0x00ff0000;
-    amask = 0xff000000;
-#endif
-
-    surface = SDL_CreateRGBSurface(0, width, height, 32,  rmask, gmask, bmask, amask);
+
+    // In the asset pack's format, so the glyphs can be cached as they are.
+    surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, PACK_PIXEL_FORMAT);
     if (surface == NULL) {
-        SDL_Log("SDL_CreateRGBSurface() failed: %s", SDL_GetError());
+        SDL_Log("SDL_CreateRGBSurfaceWithFormat() failed: %s", SDL_GetError());
     }
 
     return surface;
 }
 
 
+/*
+ * Rasterize every character into one surface, filling in map. Returns NULL
+ * if the font can't be loaded.
+ */
+static SDL_Surface *
+mapped_font_render(const char *filename,
+                   int         height,
+                   SDL_Rect   *map)
+{
+    TTF_Font    *ttf = NULL;
+    SDL_Surface *surf;
+    SDL_Surface *overall_surf = NULL;
+    int          texture_width = 0;
+    int          texture_height = 0;
+    int          char_width;
+    int          char_height;
+    char         c;
+    bool         ok = true;
 
-mapped_font_handle
-mapped_font_create(SDL_Renderer *renderer,
-                   const char   *filename,
-                   int           height)
-{
-    mapped_font_handle  result = NULL;
-    TTF_Font           *font = NULL;
-    SDL_Surface        *surf;
-    SDL_Surface        *overall_surf;
-    int                 texture_width = 0;
-    int                 texture_height = 0;
-    int                 char_width;
-    int                 char_height;
-    char                c;
-    bool                ok = true;
+    // SDL_ttf shares one FreeType library between fonts, so only one font
+    // is rasterized at a time.
+    SDL_LockMutex(mapped_font_ttf_lock);
 
     if (ok) {
-        result = calloc(1, sizeof(*result));
-        if (result == NULL) {
+        ttf = TTF_OpenFont(filename, height);
+        if (ttf == NULL) {
             ok = false;
         }
     }
 
     if (ok) {
-        font = TTF_OpenFont(filename, height);
-        if (font == NULL) {
-            ok = false;
+        // Measure every character, then pack them into as small a texture
+        // as will hold them all.
+        for (c = MIN_CHAR; c <= MAX_CHAR; c++) {
+            mapped_font_ttf_char_bounds(ttf, c, &char_width, &char_height);
+            map[CHAR_INDEX(c)].w = char_width;
+            map[CHAR_INDEX(c)].h = char_height;
         }
+
+        ok = shelf_pack(map, CHAR_COUNT, MAPPED_FONT_PADDING, &texture_width, &texture_height);
     }
 
     if (ok) {
-        // Work out the size of the final texture and create a surface that can hold all the characters.
-        for (c = MIN_CHAR; c <= MAX_CHAR; c++) {
-            mapped_font_ttf_char_bounds(font, c, &char_width, &char_height);
-            result->map[CHAR_INDEX(c)].x = texture_width;
-            result->map[CHAR_INDEX(c)].y = 0;
-            result->map[CHAR_INDEX(c)].w = char_width;
-            result->map[CHAR_INDEX(c)].h = char_height;
-
-            texture_width += char_width;
-            texture_height = char_height > texture_height ? char_height : texture_height;
-        }
-
         overall_surf = mapped_font_create_surface(texture_width, texture_height);
         if (overall_surf == NULL) {
             ok = false;
         }
     }
 
-    
     if (ok) {
         // Render characters into the overall surface.
         for (c = MIN_CHAR; c <= MAX_CHAR; c++) {
-            surf = mapped_font_ttf_char_render(font, c);
-            (void)SDL_BlitSurface(surf, NULL, overall_surf, &result->map[CHAR_INDEX(c)]);
+            surf = mapped_font_ttf_char_render(ttf, c);
+            (void)SDL_BlitSurface(surf, NULL, overall_surf, &map[CHAR_INDEX(c)]);
             SDL_FreeSurface(surf);
         }
     }
 
-    if (ok) {
-        // Create a texture from the overall surface.
-        result->texture = SDL_CreateTextureFromSurface(renderer, overall_surf);
-        if (result->texture == NULL) {
-            ok = false;
+    TTF_CloseFont(ttf);
+    SDL_UnlockMutex(mapped_font_ttf_lock);
+
+    return overall_surf;
+}
+
+
+/*
+ * Point the font at pre-rasterized glyphs, from the asset pack or the disk
+ * cache.
+ */
+static bool
+mapped_font_unpack(mapped_font_handle     font,
+                   const pack_entry_type *entry,
+                   const void            *data)
+{
+    const pack_glyph_type *glyphs = data;
+    size_t                 i;
+
+    if (entry->count != CHAR_COUNT) {
+        return false;
+    }
+
+    for (i = 0; i < CHAR_COUNT; i++) {
+        font->map[i].x = glyphs[i].x;
+        font->map[i].y = glyphs[i].y;
+        font->map[i].w = glyphs[i].w;
+        font->map[i].h = glyphs[i].h;
+    }
+
+    font->surface = SDL_CreateRGBSurfaceWithFormatFrom((void *)(glyphs + entry->count),
+                                                       (int)entry->width,
+                                                       (int)entry->height,
+                                                       32,
+                                                       (int)entry->pitch,
+                                                       entry->format);
+    return font->surface != NULL;
+}
+
+
+/*
+ * Work out where the disk cache keeps a font: named for a hash of the TTF's
+ * contents, the size and the cache version, so an edited font file or a
+ * change to how glyphs are laid out never loads stale glyphs. Returns false
+ * if there's no cache directory or the font file can't be read.
+ */
+static bool
+mapped_font_disk_name(mapped_font_handle  font,
+                      char               *filename,
+                      size_t              size)
+{
+    const uint8_t *ttf;
+    size_t         ttf_size = 0;
+    uint64_t       hash = FNV_OFFSET_BASIS;
+    size_t         i;
+
+    if (mapped_font_disk_path == NULL) {
+        return false;
+    }
+
+    ttf = platform_map_file(font->filename, &ttf_size);
+    if (ttf == NULL) {
+        return false;
+    }
+
+    for (i = 0; i < ttf_size; i++) {
+        hash = (hash ^ ttf[i]) * FNV_PRIME;
+    }
+    platform_unmap_file(ttf, ttf_size);
+
+    (void)snprintf(filename, size, "%sfont-%016llx-%d-v%d.pack",
+                   mapped_font_disk_path, (unsigned long long)hash, font->height, MAPPED_FONT_DISK_VERSION);
+
+    return true;
+}
+
+
+/*
+ * Save freshly rasterized glyphs to the disk cache for next time. Failing to
+ * is harmless, they're just rasterized again.
+ */
+static void
+mapped_font_disk_save(mapped_font_handle  font,
+                      const char         *filename)
+{
+    pack_entry_type  entry = { 0 };
+    pack_glyph_type *glyphs;
+    size_t           i;
+
+    strcpy(entry.name, MAPPED_FONT_DISK_ENTRY);
+    entry.kind = PACK_ENTRY_FONT;
+    entry.format = font->surface->format->format;
+    entry.width = (uint32_t)font->surface->w;
+    entry.height = (uint32_t)font->surface->h;
+    entry.pitch = (uint32_t)font->surface->pitch;
+    entry.count = CHAR_COUNT;
+    entry.size = CHAR_COUNT * sizeof(*glyphs) + (uint64_t)entry.pitch * entry.height;
+
+    glyphs = malloc((size_t)entry.size);
+    if (glyphs == NULL) {
+        return;
+    }
+
+    for (i = 0; i < CHAR_COUNT; i++) {
+        glyphs[i].x = font->map[i].x;
+        glyphs[i].y = font->map[i].y;
+        glyphs[i].w = font->map[i].w;
+        glyphs[i].h = font->map[i].h;
+    }
+    memcpy(glyphs + CHAR_COUNT, font->surface->pixels, (size_t)entry.pitch * entry.height);
+
+    if (!pack_file_write(filename, &entry, (const void *const *)&glyphs, 1)) {
+        SDL_Log("Failed to cache %s at %d in %s", font->filename, font->height, filename);
+    }
+
+    free(glyphs);
+}
+
+
+/*
+ * Load the font's glyphs from the asset pack or the disk cache, or failing
+ * that rasterize them and cache them. Runs on a loader thread, so only
+ * touches the font's map, surface and disk file.
+ */
+static void
+mapped_font_decode(mapped_font_handle font)
+{
+    char                   name[PACK_NAME_LENGTH];
+    char                   disk_name[FILENAME_MAX];
+    const pack_entry_type *entry;
+    bool                   cacheable;
+    PROFILE_BEGIN(load, "font.load");
+
+    pack_font_name(name, sizeof(name), font->filename, font->height);
+    entry = pack_find(name, PACK_ENTRY_FONT);
+    if (entry != NULL && mapped_font_unpack(font, entry, pack_data(entry))) {
+        PROFILE_END(load);
+        return;
+    }
+
+    // The cache file stays mapped, under the surface, until it's uploaded.
+    cacheable = mapped_font_disk_name(font, disk_name, sizeof(disk_name));
+    if (cacheable && pack_file_open(&font->disk_file, disk_name)) {
+        entry = pack_file_find(&font->disk_file, MAPPED_FONT_DISK_ENTRY, PACK_ENTRY_FONT);
+        if (entry != NULL && mapped_font_unpack(font, entry, pack_file_data(&font->disk_file, entry))) {
+            PROFILE_END(load);
+            return;
         }
+        pack_file_close(&font->disk_file);
     }
 
-    if (ok) {
-        // Set the blendmode for the new texture.
-        SDL_SetTextureBlendMode(result->texture, SDL_BLENDMODE_BLEND);
+    PROFILE_BEGIN(rasterize, "font.rasterize");
+    font->surface = mapped_font_render(font->filename, font->height, font->map);
+    PROFILE_END(rasterize);
+    if (cacheable && font->surface != NULL) {
+        mapped_font_disk_save(font, disk_name);
     }
 
-    TTF_CloseFont(font);
-    SDL_FreeSurface(overall_surf);
-    if (!ok && result != NULL) {
-        SDL_DestroyTexture(result->texture);
-        free(result);
-        result = NULL;
+    PROFILE_END(load);
+}
+
+
+/*
+ * See font.h for details.
+ */
+SDL_Surface *
+mapped_font_rasterize(const char  *filename,
+                      int          height,
+                      SDL_Rect   **map,
+                      size_t      *count)
+{
+    SDL_Surface *surface = NULL;
+
+    if (mapped_font_ttf_lock == NULL) {
+        mapped_font_ttf_lock = SDL_CreateMutex();
     }
 
-    return result;
+    *count = CHAR_COUNT;
+    *map = calloc(CHAR_COUNT, sizeof(**map));
+    if (*map != NULL) {
+        surface = mapped_font_render(filename, height, *map);
+    }
+
+    return surface;
 }
 
 
-void
-mapped_font_destroy(mapped_font_handle font)
+/*
+ * Create the texture from the rasterized characters, on the main thread.
+ * Nothing is drawn with the font until this is done.
+ */
+static void
+mapped_font_upload(mapped_font_handle font)
 {
-    SDL_DestroyTexture(font->texture);
+    SDL_Texture *texture;
+    PROFILE_BEGIN(upload, "font.upload");
+
+    if (font->surface != NULL) {
+        texture = SDL_CreateTextureFromSurface(font->renderer, font->surface);
+        if (texture != NULL) {
+            // Set the blendmode for the new texture.
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+            font->pages[MAPPED_FONT_BASE_PAGE].texture = texture;
+            batch_init(&font->batches[MAPPED_FONT_BASE_PAGE], texture);
+        }
+
+        SDL_FreeSurface(font->surface);
+        font->surface = NULL;
+    }
+
+    pack_file_close(&font->disk_file);
+    font->loading = false;
+
+    PROFILE_END(upload);
+}
+
+
+static size_t
+mapped_font_page_bytes_each(mapped_font_handle font)
+{
+    return (size_t)font->page_size * font->page_size * 4;
+}
+
+
+static void
+mapped_font_free(mapped_font_handle font)
+{
+    int page;
+
+    for (page = 0; page < MAPPED_FONT_MAX_PAGES; page++) {
+        batch_destroy(&font->batches[page]);
+        if (font->pages[page].texture != NULL) {
+            SDL_DestroyTexture(font->pages[page].texture);
+            if (page != MAPPED_FONT_BASE_PAGE) {
+                mapped_font_page_bytes -= mapped_font_page_bytes_each(font);
+            }
+        }
+    }
+
+    if (font->ttf != NULL) {
+        SDL_LockMutex(mapped_font_ttf_lock);
+        TTF_CloseFont(font->ttf);
+        SDL_UnlockMutex(mapped_font_ttf_lock);
+    }
+
+    free(font->glyphs);
+    free(font->filename);
     free(font);
 }
 
 
+mapped_font_handle
+mapped_font_acquire(SDL_Renderer *renderer,
+                    const char   *filename,
+                    int           height)
+{
+    mapped_font_handle font;
+    int                page;
+
+    for (font = mapped_font_cache; font != NULL; font = font->next) {
+        if (font->renderer == renderer && font->height == height && strcmp(font->filename, filename) == 0) {
+            font->refs++;
+            return font;
+        }
+    }
+
+    if (mapped_font_ttf_lock == NULL) {
+        mapped_font_ttf_lock = SDL_CreateMutex();
+        mapped_font_disk_path = SDL_GetPrefPath("LD41", "LD41");
+    }
+
+    font = calloc(1, sizeof(*font));
+    if (font == NULL) {
+        return NULL;
+    }
+
+    font->filename = malloc(strlen(filename) + 1);
+    if (font->filename == NULL) {
+        free(font);
+        return NULL;
+    }
+
+    strcpy(font->filename, filename);
+    font->renderer = renderer;
+    font->height = height;
+    font->refs = 1;
+    font->loading = true;
+    for (page = 0; page < MAPPED_FONT_MAX_PAGES; page++) {
+        batch_init(&font->batches[page], NULL);
+    }
+
+    font->page_size = MAPPED_FONT_PAGE_MIN_SIZE;
+    while (font->page_size < height * MAPPED_FONT_PAGE_CHARS_ACROSS && font->page_size < MAPPED_FONT_PAGE_MAX_SIZE) {
+        font->page_size *= 2;
+    }
+
+    font->next = mapped_font_cache;
+    mapped_font_cache = font;
+
+    loader_submit((loader_fn_type)&mapped_font_decode, (loader_fn_type)&mapped_font_upload, font);
+
+    return font;
+}
+
+
+void
+mapped_font_release(mapped_font_handle font)
+{
+    if (font != NULL && font->refs > 0) {
+        font->refs--;
+    }
+}
+
+
+void
+mapped_font_cache_purge(void)
+{
+    mapped_font_handle *link = &mapped_font_cache;
+    mapped_font_handle  font;
+
+    while (*link != NULL) {
+        font = *link;
+        if (font->refs == 0 && !font->loading) {
+            *link = font->next;
+            mapped_font_free(font);
+        } else {
+            link = &font->next;
+        }
+    }
+}
+
+
+bool
+mapped_font_ready(mapped_font_handle font)
+{
+    return font != NULL && font->pages[MAPPED_FONT_BASE_PAGE].texture != NULL;
+}
+
+
 void
 mapped_font_draw(SDL_Renderer       *renderer,
                  mapped_font_handle  font,
@@ -194,47 +665,466 @@ mapped_font_draw_ex(SDL_Renderer           *renderer,
                     mapped_font_align_type  align,
                     const char             *text)
 {
-    SDL_Point origin = { 0, 0 };
-    SDL_Rect  rect;
-    char      c;
-    int       width;
-    int       height;
+    PROFILE_BEGIN(draw, "font.draw_ex");
+    mapped_font_queue(font, x, y, angle, origin_x, origin_y, color, align, text);
+    mapped_font_flush(renderer, font);
+    PROFILE_END(draw);
+}
+
+
+static size_t
+mapped_font_glyph_slot(const mapped_font_type *font,
+                       uint32_t                codepoint)
+{
+    return (size_t)(codepoint * 2654435761u) & (font->glyph_size - 1);
+}
+
+
+static mapped_glyph_type *
+mapped_font_glyph_find(mapped_font_handle font,
+                       uint32_t           codepoint)
+{
+    size_t i;
+
+    if (font->glyph_size == 0) {
+        return NULL;
+    }
+
+    for (i = mapped_font_glyph_slot(font, codepoint);
+         font->glyphs[i].codepoint != 0;
+         i = (i + 1) & (font->glyph_size - 1)) {
+        if (font->glyphs[i].codepoint == codepoint) {
+            return &font->glyphs[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Add a glyph the table has room for and doesn't already hold.
+ */
+static void
+mapped_font_glyph_insert(mapped_font_handle       font,
+                         const mapped_glyph_type *glyph)
+{
+    size_t i;
+
+    for (i = mapped_font_glyph_slot(font, glyph->codepoint);
+         font->glyphs[i].codepoint != 0;
+         i = (i + 1) & (font->glyph_size - 1)) {
+    }
+
+    font->glyphs[i] = *glyph;
+    font->glyph_count++;
+}
+
+
+/*
+ * Rebuild the glyph table with size slots, leaving out the glyphs on
+ * dropped_page (none, given the base page). Returns false, changing nothing,
+ * if memory runs out.
+ */
+static bool
+mapped_font_glyph_rehash(mapped_font_handle font,
+                         size_t             size,
+                         int                dropped_page)
+{
+    mapped_glyph_type *old_glyphs = font->glyphs;
+    size_t             old_size = font->glyph_size;
+    size_t             i;
+
+    font->glyphs = calloc(size, sizeof(*font->glyphs));
+    if (font->glyphs == NULL) {
+        font->glyphs = old_glyphs;
+        return false;
+    }
+
+    font->glyph_size = size;
+    font->glyph_count = 0;
+    for (i = 0; i < old_size; i++) {
+        if (old_glyphs[i].codepoint != 0 &&
+            (dropped_page == MAPPED_FONT_BASE_PAGE || old_glyphs[i].page != dropped_page)) {
+            mapped_font_glyph_insert(font, &old_glyphs[i]);
+        }
+    }
+
+    free(old_glyphs);
+
+    return true;
+}
+
+
+/*
+ * Find the least recently drawn extra page, of any font or just only's, that
+ * can be evicted. Pages with quads queued on them are never evicted, which is
+ * what keeps anything drawn this frame. The clock only orders the rest, and
+ * keeps the pages the layout under way has drawn from, which are stamped with
+ * its current value.
+ */
+static bool
+mapped_font_page_coldest(mapped_font_handle  only,
+                         mapped_font_handle *font,
+                         int                *page)
+{
+    mapped_font_handle candidate;
+    int                i;
+    bool               found = false;
+
+    for (candidate = mapped_font_cache; candidate != NULL; candidate = candidate->next) {
+        if (only != NULL && candidate != only) {
+            continue;
+        }
+
+        for (i = MAPPED_FONT_BASE_PAGE + 1; i < MAPPED_FONT_MAX_PAGES; i++) {
+            if (candidate->pages[i].texture != NULL &&
+                candidate->pages[i].last_used != mapped_font_clock &&
+                candidate->batches[i].count == 0 &&
+                (!found || candidate->pages[i].last_used < (*font)->pages[*page].last_used)) {
+                *font = candidate;
+                *page = i;
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+
+/*
+ * Free an extra page and forget the glyphs on it. Text laid out with them
+ * sees the generation change and lays itself out again.
+ */
+static bool
+mapped_font_page_evict(mapped_font_handle font,
+                       int                page)
+{
+    if (!mapped_font_glyph_rehash(font, font->glyph_size, page)) {
+        return false;
+    }
+
+    SDL_DestroyTexture(font->pages[page].texture);
+    font->pages[page].texture = NULL;
+    batch_destroy(&font->batches[page]);
+    batch_init(&font->batches[page], NULL);
+    mapped_font_page_bytes -= mapped_font_page_bytes_each(font);
+    font->generation++;
+
+    return true;
+}
+
+
+/*
+ * Start a new, empty extra page, evicting cold ones to stay within budget.
+ * Returns its index, or the base page if there's no room for one.
+ */
+static int
+mapped_font_page_add(mapped_font_handle font)
+{
+    size_t              bytes = mapped_font_page_bytes_each(font);
+    mapped_font_handle  owner;
+    SDL_Texture        *texture;
+    void               *pixels;
+    int                 page;
+
+    while (mapped_font_page_bytes + bytes > MAPPED_FONT_PAGE_BUDGET &&
+           mapped_font_page_coldest(NULL, &owner, &page) &&
+           mapped_font_page_evict(owner, page)) {
+    }
+
+    for (page = MAPPED_FONT_BASE_PAGE + 1; page < MAPPED_FONT_MAX_PAGES; page++) {
+        if (font->pages[page].texture == NULL) {
+            break;
+        }
+    }
+
+    if (page == MAPPED_FONT_MAX_PAGES &&
+        !(mapped_font_page_coldest(font, &owner, &page) && mapped_font_page_evict(owner, page))) {
+        return MAPPED_FONT_BASE_PAGE;
+    }
+
+    texture = SDL_CreateTexture(font->renderer, PACK_PIXEL_FORMAT, SDL_TEXTUREACCESS_STATIC, font->page_size, font->page_size);
+    if (texture == NULL) {
+        SDL_Log("SDL_CreateTexture() failed: %s", SDL_GetError());
+        return MAPPED_FONT_BASE_PAGE;
+    }
+
+    // New textures hold garbage, and filtering samples the padding between
+    // glyphs, so start clear.
+    pixels = calloc(1, bytes);
+    if (pixels == NULL) {
+        SDL_DestroyTexture(texture);
+        return MAPPED_FONT_BASE_PAGE;
+    }
+    (void)SDL_UpdateTexture(texture, NULL, pixels, font->page_size * 4);
+    free(pixels);
+
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    font->pages[page].texture = texture;
+    font->pages[page].last_used = mapped_font_clock;
+    shelf_init(&font->pages[page].shelf, font->page_size, font->page_size);
+    batch_destroy(&font->batches[page]);
+    batch_init(&font->batches[page], texture);
+    mapped_font_page_bytes += bytes;
+
+    return page;
+}
+
+
+/*
+ * Find room for a rasterized glyph on an extra page and copy it there.
+ */
+static bool
+mapped_font_page_place(mapped_font_handle  font,
+                       SDL_Surface        *surface,
+                       mapped_glyph_type  *glyph)
+{
+    int page;
+
+    for (page = MAPPED_FONT_BASE_PAGE + 1; page < MAPPED_FONT_MAX_PAGES; page++) {
+        if (font->pages[page].texture != NULL &&
+            shelf_alloc(&font->pages[page].shelf, surface->w, surface->h, MAPPED_FONT_PADDING, &glyph->rect)) {
+            break;
+        }
+    }
+
+    if (page == MAPPED_FONT_MAX_PAGES) {
+        page = mapped_font_page_add(font);
+        if (page == MAPPED_FONT_BASE_PAGE ||
+            !shelf_alloc(&font->pages[page].shelf, surface->w, surface->h, MAPPED_FONT_PADDING, &glyph->rect)) {
+            return false;
+        }
+    }
+
+    (void)SDL_UpdateTexture(font->pages[page].texture, &glyph->rect, surface->pixels, surface->pitch);
+    glyph->page = page;
+
+    return true;
+}
+
+
+/*
+ * Rasterize a character outside the base set, in the pages' format.
+ */
+static SDL_Surface *
+mapped_font_glyph_render(mapped_font_handle font,
+                         uint32_t           codepoint)
+{
+    SDL_Color    white = { 255, 255, 255, 255 };
+    SDL_Surface *surface;
+    SDL_Surface *converted;
+    char         buf[5];
+    PROFILE_BEGIN(glyph, "font.glyph");
+
+    SDL_LockMutex(mapped_font_ttf_lock);
+    if (font->ttf == NULL && !font->ttf_failed) {
+        font->ttf = TTF_OpenFont(font->filename, font->height);
+        if (font->ttf == NULL) {
+            SDL_Log("Failed to open %s at %d: %s", font->filename, font->height, TTF_GetError());
+            font->ttf_failed = true;
+        }
+    }
+
+    surface = NULL;
+    if (font->ttf != NULL) {
+        mapped_font_utf8_encode(codepoint, buf);
+        surface = TTF_RenderUTF8_Blended(font->ttf, buf, white);
+    }
+    SDL_UnlockMutex(mapped_font_ttf_lock);
+
+    if (surface != NULL && surface->format->format != PACK_PIXEL_FORMAT) {
+        converted = SDL_ConvertSurfaceFormat(surface, PACK_PIXEL_FORMAT, 0);
+        SDL_FreeSurface(surface);
+        surface = converted;
+    }
+
+    PROFILE_END(glyph);
+    return surface;
+}
+
+
+/*
+ * Where to find a character's glyph, rasterizing it if it's the first time
+ * it's drawn. Returns false if there's nothing to draw, e.g. the font
+ * doesn't have it, or there's no room for it this time.
+ */
+static bool
+mapped_font_glyph(mapped_font_handle  font,
+                  uint32_t            codepoint,
+                  int                *page,
+                  SDL_Rect           *rect)
+{
+    mapped_glyph_type *found;
+    mapped_glyph_type  glyph;
+    SDL_Surface       *surface;
+
+    if (codepoint >= MIN_CHAR && codepoint <= MAX_CHAR) {
+        *page = MAPPED_FONT_BASE_PAGE;
+        *rect = font->map[CHAR_INDEX(codepoint)];
+        return true;
+    }
+
+    found = mapped_font_glyph_find(font, codepoint);
+    if (found == NULL) {
+        if (font->ttf_failed) {
+            return false;
+        }
+
+        // Grow the table at half full, so probes stay short.
+        if ((font->glyph_count + 1) * 2 > font->glyph_size &&
+            !mapped_font_glyph_rehash(font,
+                                      font->glyph_size > 0 ? font->glyph_size * 2 : MAPPED_FONT_GLYPHS_MIN_SIZE,
+                                      MAPPED_FONT_BASE_PAGE)) {
+            return false;
+        }
+
+        memset(&glyph, 0, sizeof(glyph));
+        glyph.codepoint = codepoint;
+        surface = mapped_font_glyph_render(font, codepoint);
+        if (surface == NULL && font->ttf_failed) {
+            return false;
+        }
+
+        // A glyph too big for a page is as good as missing.
+        if (surface != NULL &&
+            surface->w + MAPPED_FONT_PADDING * 2 <= font->page_size &&
+            surface->h + MAPPED_FONT_PADDING * 2 <= font->page_size &&
+            !mapped_font_page_place(font, surface, &glyph)) {
+            SDL_FreeSurface(surface);
+            return false;
+        }
+        SDL_FreeSurface(surface);
+
+        mapped_font_glyph_insert(font, &glyph);
+        found = mapped_font_glyph_find(font, codepoint);
+    }
+
+    if (found->rect.w <= 0 || found->rect.h <= 0) {
+        return false;
+    }
+
+    font->pages[found->page].last_used = mapped_font_clock;
+    *page = found->page;
+    *rect = found->rect;
+
+    return true;
+}
+
+
+/*
+ * Lay a string out into batches, one for each of the font's pages, measuring
+ * it as we go so that it can then be aligned without a second pass.
+ */
+static void
+mapped_font_layout(mapped_font_handle      font,
+                   batch_type             *batches,
+                   int                     x,
+                   int                     y,
+                   float                   angle,
+                   int                     origin_x,
+                   int                     origin_y,
+                   SDL_Color               color,
+                   mapped_font_align_type  align,
+                   const char             *text)
+{
+    batch_quad_type *quad;
+    SDL_Rect         src;
+    SDL_Rect         rect;
+    size_t           first[MAPPED_FONT_MAX_PAGES];
+    size_t           i;
+    int              page;
+    int              width = 0;
+    int              shift = 0;
+    uint32_t         codepoint;
+
+    // Nothing can be drawn until the font has loaded.
+    if (!mapped_font_ready(font)) {
+        return;
+    }
+
+    for (page = 0; page < MAPPED_FONT_MAX_PAGES; page++) {
+        first[page] = batches[page].count;
+    }
 
-    SDL_SetTextureColorMod(font->texture, color.r, color.g, color.b);
+    // Stamp the pages drawn from with a new time, so making room for a later
+    // glyph in the same text can't evict them.
+    mapped_font_clock++;
+
+    while (*text != '\0') {
+        codepoint = mapped_font_utf8_next(&text);
+
+        // If the char is a control character, or there's no glyph for it,
+        // just skip it.
+        if (!mapped_font_char_ok(codepoint) || !mapped_font_glyph(font, codepoint, &page, &src)) {
+            continue;
+        }
+
+        rect.x = x + width;
+        rect.y = y;
+        rect.w = src.w;
+        rect.h = src.h;
+        if (batch_add(&batches[page], &src, &rect, color) == NULL) {
+            break;
+        }
+
+        width += rect.w;
+    }
 
     switch (align) {
     case ALIGN_LEFT:
         break;
 
     case ALIGN_CENTER:
-        mapped_font_bounds(font, text, &width, &height);
-        x -= width / 2;
+        shift = width / 2;
         break;
 
     case ALIGN_RIGHT:
-        mapped_font_bounds(font, text, &width, &height);
-        x -= width;
+        shift = width;
         break;
     }
 
-    for (; *text != '\0'; text++) {
-        c = *text;
+    // Unrotated, left-aligned text (the usual case) is already in place.
+    if (shift == 0 && angle == 0.0f) {
+        return;
+    }
 
-        // If the char is outside the printable range, just skip it.
-        if (!mapped_font_char_ok(c)) {
-            continue;
+    for (page = 0; page < MAPPED_FONT_MAX_PAGES; page++) {
+        for (i = first[page]; i < batches[page].count; i++) {
+            quad = &batches[page].quads[i];
+            quad->dest.x -= shift;
+            quad->angle = angle;
+            quad->origin.x = origin_x;
+            quad->origin.y = origin_y;
         }
-           
-        rect.x = x;
-        rect.y = y;
-        origin.x = origin_x - rect.x;
-        origin.y = origin_y - rect.y;
-        rect.w = font->map[CHAR_INDEX(c)].w;
-        rect.h = font->map[CHAR_INDEX(c)].h;
+    }
+}
+
 
-        SDL_RenderCopyEx(renderer, font->texture, &font->map[CHAR_INDEX(c)], &rect, RAD_TO_DEG(angle), &origin, SDL_FLIP_NONE);
+void
+mapped_font_queue(mapped_font_handle      font,
+                  int                     x,
+                  int                     y,
+                  float                   angle,
+                  int                     origin_x,
+                  int                     origin_y,
+                  SDL_Color               color,
+                  mapped_font_align_type  align,
+                  const char             *text)
+{
+    mapped_font_layout(font, font->batches, x, y, angle, origin_x, origin_y, color, align, text);
+}
 
-        x += rect.w;
+
+void
+mapped_font_flush(SDL_Renderer       *renderer,
+                  mapped_font_handle  font)
+{
+    int page;
+
+    for (page = 0; page < MAPPED_FONT_MAX_PAGES; page++) {
+        batch_flush(&font->batches[page], renderer);
     }
 }
 
@@ -245,16 +1135,25 @@ mapped_font_bounds(mapped_font_handle  font,
                    int                *width,
                    int                *height)
 {
-    SDL_Rect *char_bounds;
+    SDL_Rect char_bounds;
+    uint32_t codepoint;
+    int      page;
+
+    *width = 0;
+    *height = 0;
+    if (!mapped_font_ready(font)) {
+        return;
+    }
 
-    for (*width = 0, *height = 0; *text != '\0'; text++) {
-        if (!mapped_font_char_ok(*text)) {
+    mapped_font_clock++;
+    while (*text != '\0') {
+        codepoint = mapped_font_utf8_next(&text);
+        if (!mapped_font_char_ok(codepoint) || !mapped_font_glyph(font, codepoint, &page, &char_bounds)) {
             continue;
         }
 
-        char_bounds = &font->map[CHAR_INDEX(*text)];
-        *width += char_bounds->w;
-        *height = char_bounds->h > *height ? char_bounds->h : *height;
+        *width += char_bounds.w;
+        *height = char_bounds.h > *height ? char_bounds.h : *height;
     }
 }
 
@@ -295,3 +1194,148 @@ mapped_font_drawf_ex(SDL_Renderer           *renderer,
     va_end(args);
 }
 
+
+void
+mapped_font_queuef(mapped_font_handle      font,
+                   int                     x,
+                   int                     y,
+                   mapped_font_align_type  align,
+                   const char             *fmt,
+                   ...)
+{
+    char buf[256];
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, 256, fmt, args);
+    mapped_font_queue(font, x, y, 0, 0, 0, color_white, align, buf);
+    va_end(args);
+}
+
+
+mapped_text_handle
+mapped_text_create(mapped_font_handle      font,
+                   int                     x,
+                   int                     y,
+                   SDL_Color               color,
+                   mapped_font_align_type  align)
+{
+    mapped_text_handle text;
+    int                page;
+
+    text = calloc(1, sizeof(*text));
+    if (text != NULL) {
+        text->font = font;
+        text->x = x;
+        text->y = y;
+        text->color = color;
+        text->align = align;
+        for (page = 0; page < MAPPED_FONT_MAX_PAGES; page++) {
+            batch_init(&text->layouts[page], NULL);
+        }
+    }
+
+    return text;
+}
+
+
+void
+mapped_text_destroy(mapped_text_handle text)
+{
+    int page;
+
+    if (text == NULL) {
+        return;
+    }
+
+    for (page = 0; page < MAPPED_FONT_MAX_PAGES; page++) {
+        batch_destroy(&text->layouts[page]);
+    }
+    free(text->string);
+    free(text);
+}
+
+
+static void
+mapped_text_layout(mapped_text_handle text)
+{
+    int page;
+
+    for (page = 0; page < MAPPED_FONT_MAX_PAGES; page++) {
+        text->layouts[page].count = 0;
+    }
+
+    text->laid_out = mapped_font_ready(text->font);
+    mapped_font_layout(text->font, text->layouts, text->x, text->y, 0, 0, 0, text->color, text->align, text->string);
+
+    // Pages drawn from by this layout can't have been evicted during it.
+    text->generation = text->font->generation;
+}
+
+
+void
+mapped_text_set(mapped_text_handle  text,
+                const char         *string)
+{
+    char *copy;
+
+    if (text->string == NULL || strcmp(text->string, string) != 0) {
+        copy = malloc(strlen(string) + 1);
+        if (copy == NULL) {
+            return;
+        }
+        strcpy(copy, string);
+        free(text->string);
+        text->string = copy;
+    }
+
+    text->key_set = false;
+    mapped_text_layout(text);
+}
+
+
+void
+mapped_text_setf(mapped_text_handle  text,
+                 uint64_t            key,
+                 const char         *fmt,
+                 ...)
+{
+    char buf[256];
+
+    if (text->key_set && text->key == key) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, 256, fmt, args);
+    mapped_text_set(text, buf);
+    va_end(args);
+
+    text->key = key;
+    text->key_set = true;
+}
+
+
+void
+mapped_text_queue(mapped_text_handle text)
+{
+    mapped_font_handle font = text->font;
+    int                page;
+
+    // Lay the text out now if the font has loaded since it was set, or
+    // evicted a page it was using.
+    if (text->string != NULL && mapped_font_ready(font) &&
+        (!text->laid_out || text->generation != font->generation)) {
+        mapped_text_layout(text);
+    }
+
+    // Queued pages are kept by their quads; the new time is for ordering.
+    mapped_font_clock++;
+    for (page = 0; page < MAPPED_FONT_MAX_PAGES; page++) {
+        if (text->layouts[page].count > 0) {
+            font->pages[page].last_used = mapped_font_clock;
+            (void)batch_append(&font->batches[page], text->layouts[page].quads, text->layouts[page].count);
+        }
+    }
+}
@@ -2,10 +2,14 @@
 #define __FONT_H__
 
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <SDL.h>
 #include <SDL2/SDL_ttf.h>
 
 typedef struct mapped_font *mapped_font_handle;
+typedef struct mapped_text *mapped_text_handle;
 
 
 typedef enum {
@@ -15,10 +19,48 @@ typedef enum {
 } mapped_font_align_type;
 
 
-mapped_font_handle mapped_font_create(SDL_Renderer *renderer,
-                                      const char   *filename,
-                                      int           height);
-void mapped_font_destroy(mapped_font_handle font);
+/*
+ * Fonts are shared, one per renderer, file and size. Acquiring a font that
+ * has been loaded before just takes another reference to it, so states that
+ * come and go (e.g. the menus on every restart) don't rasterize anything.
+ * Released fonts stay cached until mapped_font_cache_purge. Only call these
+ * from the thread that owns the renderer.
+ *
+ * The glyphs come from the asset pack if it has the font at that size (see
+ * pack.h), or else from a cache in the user's pref path, keyed by the TTF's
+ * contents and the size, so FreeType only runs the first time a font is used.
+ * That covers printable ASCII. Text is UTF-8, and any other character is
+ * rasterized the first time it's drawn, onto extra pages that are evicted
+ * when they go unused and fonts need the memory.
+ */
+mapped_font_handle mapped_font_acquire(SDL_Renderer *renderer,
+                                       const char   *filename,
+                                       int           height);
+void mapped_font_release(mapped_font_handle font);
+
+/*
+ * Free every cached font that nothing holds a reference to and isn't still
+ * loading.
+ */
+void mapped_font_cache_purge(void);
+
+/*
+ * Rasterize a font the way mapped_font_acquire does, for LD41Pack to bake into
+ * an asset pack (see pack.h). map is allocated with a rect for each glyph in
+ * the returned surface, count of them, and is the caller's to free. Returns
+ * NULL if the font can't be loaded.
+ */
+SDL_Surface *mapped_font_rasterize(const char  *filename,
+                                   int          height,
+                                   SDL_Rect   **map,
+                                   size_t      *count);
+
+/*
+ * Fonts are rasterized through the loader (see loader.h), so may arrive a
+ * few frames after they're acquired. Until then, text drawn with them is
+ * skipped, apart from mapped_text, which is laid out once the font arrives.
+ */
+bool mapped_font_ready(mapped_font_handle font);
 
 void mapped_font_draw(SDL_Renderer       *renderer,
                       mapped_font_handle  font,
@@ -52,10 +94,66 @@ void mapped_font_drawf_ex(SDL_Renderer           *renderer,
                           const char             *fmt,
                           ...);
 
+/*
+ * Queue text to go out with the font's next mapped_font_flush, so any number
+ * of strings in one font cost a single draw call. The mapped_font_draw
+ * functions queue and flush straight away.
+ */
+void mapped_font_queue(mapped_font_handle      font,
+                       int                     x,
+                       int                     y,
+                       float                   angle,
+                       int                     origin_x,
+                       int                     origin_y,
+                       SDL_Color               color,
+                       mapped_font_align_type  align,
+                       const char             *text);
+
+void mapped_font_queuef(mapped_font_handle      font,
+                        int                     x,
+                        int                     y,
+                        mapped_font_align_type  align,
+                        const char             *fmt,
+                        ...);
+
+void mapped_font_flush(SDL_Renderer       *renderer,
+                       mapped_font_handle  font);
+
 void mapped_font_bounds(mapped_font_handle  font,
                         const char         *text,
                         int                *width,
                         int                *height);
 
 
+/*
+ * A string laid out once and kept, for text that is drawn every frame but
+ * rarely changes. Queuing it copies the cached glyphs into the font's
+ * batches, with no formatting or layout, unless the font has evicted a page
+ * since.
+ */
+mapped_text_handle mapped_text_create(mapped_font_handle      font,
+                                      int                     x,
+                                      int                     y,
+                                      SDL_Color               color,
+                                      mapped_font_align_type  align);
+void mapped_text_destroy(mapped_text_handle text);
+
+void mapped_text_set(mapped_text_handle  text,
+                     const char         *string);
+
+/*
+ * Format and lay out the text, unless key (e.g. the value being shown) is the
+ * same as last time, in which case nothing is done.
+ */
+void mapped_text_setf(mapped_text_handle  text,
+                      uint64_t            key,
+                      const char         *fmt,
+                      ...);
+
+/*
+ * Queue the text to go out with its font's next mapped_font_flush.
+ */
+void mapped_text_queue(mapped_text_handle text);
+
+
 #endif /* __FONT_H__ */
@@ -1,70 +1,48 @@
 #include <assert.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <SDL.h>
 #include <SDL_mixer.h>
 
+#include "asset.h"
+#include "atlas.h"
 #include "font.h"
 #include "gameover.h"
 #include "gamestate.h"
+#include "main.h"
+#include "move.h"
+#include "profile.h"
+#include "sim.h"
 #include "utils.h"
 
 
-typedef enum tile {
-    TILE_SHIP,
-    TILE_LASER,
-    TILE_ENEMY_LASER,
-    TILE_ENEMY,
-    TILE_ASTEROID_1,
-    TILE_ASTEROID_2,
-    TILE_ASTEROID_3,
-    TILE_BOMB,
-    TILE_EMPTY,
-    TILE_COUNT = TILE_EMPTY,
-} tile_type;
-
-tile_type tile_weights[] = {
-    TILE_SHIP, TILE_SHIP, TILE_SHIP, TILE_SHIP,
-    TILE_ENEMY, TILE_ENEMY, TILE_ENEMY, TILE_ENEMY,
-    TILE_LASER, TILE_LASER, TILE_LASER, TILE_LASER, TILE_LASER, TILE_LASER,
-    TILE_ENEMY_LASER, TILE_ENEMY_LASER, TILE_ENEMY_LASER,
-    TILE_ASTEROID_1, TILE_ASTEROID_1, TILE_ASTEROID_1, TILE_ASTEROID_1, TILE_ASTEROID_1, TILE_ASTEROID_1, TILE_ASTEROID_1, TILE_ASTEROID_1, TILE_ASTEROID_1, TILE_ASTEROID_1, TILE_ASTEROID_1, TILE_ASTEROID_1,
-    TILE_ASTEROID_2, TILE_ASTEROID_2, TILE_ASTEROID_2, TILE_ASTEROID_2, TILE_ASTEROID_2, TILE_ASTEROID_2, TILE_ASTEROID_2, TILE_ASTEROID_2, TILE_ASTEROID_2, TILE_ASTEROID_2, TILE_ASTEROID_2, TILE_ASTEROID_2,
-    TILE_ASTEROID_3, TILE_ASTEROID_3, TILE_ASTEROID_3, TILE_ASTEROID_3, TILE_ASTEROID_3, TILE_ASTEROID_3, TILE_ASTEROID_3, TILE_ASTEROID_3, TILE_ASTEROID_3, TILE_ASTEROID_3, TILE_ASTEROID_3, TILE_ASTEROID_3,
-    TILE_BOMB
-};
-
-typedef struct coord {
-    size_t x;
-    size_t y;
-} coord_type;
-
-#define BOARD_WIDTH 8
-#define BOARD_HEIGHT 8
-
-// TODO: Resolution magic numbers
-#define TILE_WIDTH (800 / BOARD_WIDTH)
-#define TILE_HEIGHT (800 / BOARD_HEIGHT)
+// The board fills a square on the left of the window, with the HUD beside it.
+#define BOARD_PIXELS ((int)main_screen_height())
 
 #define HUD_PADDING 10
-#define HUD_WIDTH (1280 - 800 - HUD_PADDING * 2)
-#define HUD_START_X (TILE_WIDTH * BOARD_WIDTH + HUD_PADDING)
+#define HUD_WIDTH ((int)main_screen_width() - BOARD_PIXELS - HUD_PADDING * 2)
+#define HUD_START_X (BOARD_PIXELS + HUD_PADDING)
 #define HUD_BAR_HEIGHT 48
 
 #define HUD_TEXT_HEIGHT 32
 #define HUD_TEXT_LARGE_HEIGHT 64
 
-#define MAX_ENERGY 100
-#define MOVE_ENERGY 12
-#define KILL_ENERGY 25
-#define DIE_ENERGY 35
-#define MATCH_ENERGY 3
-#define TICK_ENERGY 1
+#define HUD_TOP 6
+#define HUD_ENERGY_BAR_Y (HUD_TOP + HUD_TEXT_HEIGHT)
+#define HUD_SCORE_LABEL_Y (HUD_ENERGY_BAR_Y + HUD_BAR_HEIGHT + HUD_TEXT_HEIGHT)
+#define HUD_SCORE_Y (HUD_SCORE_LABEL_Y + HUD_TEXT_HEIGHT)
+#define HUD_TIME_LABEL_Y (HUD_SCORE_Y + HUD_TEXT_LARGE_HEIGHT)
+#define HUD_TIME_Y (HUD_TIME_LABEL_Y + HUD_TEXT_HEIGHT)
+
+#define DROP_TICKS GAMESTATE_TICKS(0.1)
+#define SWAP_TICKS GAMESTATE_TICKS(0.1)
+#define ENERGY_TICKS GAMESTATE_TICKS(5.0)
 
-#define DROP_TIME 0.1f
-#define SWAP_TIME 0.1f
-#define ENERGY_TICK_TIME 5.0f
+// In board_tiles, for cells that have to be drawn whatever the sim holds.
+#define BOARD_TILE_UNKNOWN UINT8_MAX
 
 typedef enum {
     GAME_STATE_IDLE,
@@ -72,66 +50,107 @@ typedef enum {
     GAME_STATE_SWAPPING,
 } game_state_type;
 
+// Every sprite the game draws, packed into one atlas. Each energy bar's
+// left, mid and right pieces must stay in that order.
+typedef enum {
+    GAME_SPRITE_SHIP,
+    GAME_SPRITE_ENEMY,
+    GAME_SPRITE_ASTEROID_1,
+    GAME_SPRITE_ASTEROID_2,
+    GAME_SPRITE_ASTEROID_3,
+    GAME_SPRITE_BOMB,
+    GAME_SPRITE_LASER,
+    GAME_SPRITE_ENEMY_LASER,
+    GAME_SPRITE_ENERGY_BAR,
+    GAME_SPRITE_ENERGY_BAR_BACK = GAME_SPRITE_ENERGY_BAR + 3,
+    GAME_SPRITE_ENERGY_BAR_YELLOW = GAME_SPRITE_ENERGY_BAR_BACK + 3,
+    GAME_SPRITE_ENERGY_BAR_RED = GAME_SPRITE_ENERGY_BAR_YELLOW + 3,
+    GAME_SPRITE_COUNT = GAME_SPRITE_ENERGY_BAR_RED + 3,
+} game_sprite_type;
+
+static const char *const game_sprite_files[GAME_SPRITE_COUNT] = {
+    "media/textures/player.png",
+    "media/textures/enemyShip.png",
+    "media/textures/asteroid_1.png",
+    "media/textures/asteroid_2.png",
+    "media/textures/asteroid_3.png",
+    "media/textures/enemyUFO.png",
+    "media/textures/laser.png",
+    "media/textures/enemyLaser.png",
+    "media/textures/energy_left.png",
+    "media/textures/energy_mid.png",
+    "media/textures/energy_right.png",
+    "media/textures/energy_back_left.png",
+    "media/textures/energy_back_mid.png",
+    "media/textures/energy_back_right.png",
+    "media/textures/energy_yellow_left.png",
+    "media/textures/energy_yellow_mid.png",
+    "media/textures/energy_yellow_right.png",
+    "media/textures/energy_red_left.png",
+    "media/textures/energy_red_mid.png",
+    "media/textures/energy_red_right.png",
+};
+
+static const game_sprite_type game_tile_sprites[TILE_COUNT] = {
+    [TILE_SHIP] = GAME_SPRITE_SHIP,
+    [TILE_LASER] = GAME_SPRITE_LASER,
+    [TILE_ENEMY_LASER] = GAME_SPRITE_ENEMY_LASER,
+    [TILE_ENEMY] = GAME_SPRITE_ENEMY,
+    [TILE_ASTEROID_1] = GAME_SPRITE_ASTEROID_1,
+    [TILE_ASTEROID_2] = GAME_SPRITE_ASTEROID_2,
+    [TILE_ASTEROID_3] = GAME_SPRITE_ASTEROID_3,
+    [TILE_BOMB] = GAME_SPRITE_BOMB,
+};
+
 typedef struct game_info {
     SDL_Renderer   *renderer;
-    tile_type       tiles[BOARD_HEIGHT][BOARD_WIDTH];
-    tile_type       next_row[BOARD_WIDTH];
-    float           game_time;
+    sim_type        sim;
+    uint64_t        game_ticks;
     game_state_type game_state;
-    float           update_time;
-    float           tick_time;
+    uint64_t        update_ticks;  // When the swap or drop under way started.
+    uint64_t        energy_ticks;  // When energy was last lost.
     coord_type      mouse_down_coords;
     coord_type      swap_a;
     coord_type      swap_b;
-    uint8_t         energy;
-    uint32_t        score;
-    uint8_t         chain;
+    int             tile_width;
+    int             tile_height;
+    uint16_t       *falls;     // Rows each tile is falling in the current drop, by sim_index.
+    unsigned int    drop_rows; // Furthest any tile is falling.
+    move_type       hint;
+    bool            hint_shown;
+
+    // The board as last drawn, so each frame only draws the tiles that have
+    // changed. NULL where the renderer can't draw to textures, in which case
+    // every tile is drawn every frame.
+    SDL_Texture    *board;
+    uint8_t        *board_tiles;   // The tile drawn in each cell of board, by sim_index.
+    uint64_t        board_changes; // sim.changes as of the last update of board.
+    bool            board_settled; // Whether that update drew the sim with nothing moving.
 
     // Fonts
     mapped_font_handle hud_font;
     mapped_font_handle hud_font_large;
 
-    // Textures
-    SDL_Texture *ship_texture;
-    SDL_Texture *enemy_texture;
-    SDL_Texture *asteroid_1_texture;
-    SDL_Texture *asteroid_2_texture;
-    SDL_Texture *asteroid_3_texture;
-    SDL_Texture *bomb_texture;
-    SDL_Texture *laser_texture;
-    SDL_Texture *enemy_laser_texture;
-    SDL_Texture *energy_bar_left;
-    SDL_Texture *energy_bar_mid;
-    SDL_Texture *energy_bar_right;
-    SDL_Texture *energy_bar_back_left;
-    SDL_Texture *energy_bar_back_mid;
-    SDL_Texture *energy_bar_back_right;
-    SDL_Texture *energy_bar_yellow_left;
-    SDL_Texture *energy_bar_yellow_mid;
-    SDL_Texture *energy_bar_yellow_right;
-    SDL_Texture *energy_bar_red_left;
-    SDL_Texture *energy_bar_red_mid;
-    SDL_Texture *energy_bar_red_right;
+    // HUD text, laid out again only when it changes
+    mapped_text_handle energy_label;
+    mapped_text_handle score_label;
+    mapped_text_handle time_label;
+    mapped_text_handle score_text;
+    mapped_text_handle time_text;
+
+    // Sprites, drawn in one batch per frame
+    asset_handle atlas;
 
     // Sounds
-    Mix_Chunk *swap_sound;
-    Mix_Chunk *shoot_sound;
-    Mix_Chunk *enemy_shoot_sound;
-    Mix_Chunk *match_sound;
+    asset_handle swap_sound;
+    asset_handle shoot_sound;
+    asset_handle enemy_shoot_sound;
+    asset_handle match_sound;
 } game_info_type;
 
-game_lose_energy(game_info_type *game,
-                 uint8_t         damage)
-{
-    if (game->energy > damage) {
-        game->energy -= damage;
-    } else {
-        game->energy = 0;
-    }
-}
-
 static void
 game_draw_tile(SDL_Renderer *renderer,
+               const game_info_type *game,
                size_t x,
                size_t y,
                uint8_t r,
@@ -142,233 +161,177 @@ game_draw_tile(SDL_Renderer *renderer,
     SDL_Rect rect;
 
     SDL_SetRenderDrawColor(renderer, r, g, b, 255);
-    rect.x = x * TILE_WIDTH;
-    rect.y = y * TILE_HEIGHT + y_offset;
-    rect.w = TILE_WIDTH;
-    rect.h = TILE_HEIGHT;
+    rect.x = (int)x * game->tile_width;
+    rect.y = (int)y * game->tile_height + y_offset;
+    rect.w = game->tile_width;
+    rect.h = game->tile_height;
     SDL_RenderFillRect(renderer, &rect);
 }
 
 static void
-game_draw_tile_textured(SDL_Renderer *renderer,
-                        SDL_Texture *texture,
-                        size_t x,
-                        size_t y,
-                        int x_offset,
-                        int y_offset)
+game_draw_sprite(const game_info_type *game,
+                 game_sprite_type sprite,
+                 int x,
+                 int y,
+                 int width,
+                 int height)
 {
-    SDL_Rect rect;
+    SDL_Rect rect = { .x = x,.y = y,.w = width,.h = height };
+    atlas_handle atlas = asset_atlas(game->atlas);
 
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-    rect.x = x * TILE_WIDTH + x_offset;
-    rect.y = y * TILE_HEIGHT + y_offset;
-    rect.w = TILE_WIDTH;
-    rect.h = TILE_HEIGHT;
-    SDL_RenderCopy(renderer, texture, NULL, &rect);
+    // Queued up to be drawn together at the end of game_draw. Nothing is
+    // drawn until the atlas has loaded.
+    if (atlas != NULL) {
+        atlas_draw(atlas, sprite, &rect);
+    }
 }
 
-static coord_type
-game_window_coords_to_tile (int32_t x, int32_t y)
+static void
+game_play_sound(asset_handle sound)
 {
-    coord_type res;
-    res.x = x / TILE_WIDTH;
-    res.y = y / TILE_HEIGHT;
-    return res;
+    // Sounds that haven't loaded yet are skipped.
+    if (asset_sound(sound) != NULL) {
+        Mix_PlayChannel(-1, asset_sound(sound), 0);
+    }
 }
 
 static void
-game_mark_erased(bool erase_tiles[BOARD_HEIGHT][BOARD_WIDTH],
-                 size_t start_x,
-                 size_t start_y,
-                 size_t x_inc,
-                 size_t y_inc,
-                 size_t distance) {
-    for (size_t i = 0; i <= distance; i++) {
-        erase_tiles[start_x + i * x_inc][start_y + i * y_inc] = true;
-    }
+game_draw_tile_textured(const game_info_type *game,
+                        game_sprite_type sprite,
+                        size_t x,
+                        size_t y,
+                        int x_offset,
+                        int y_offset)
+{
+    game_draw_sprite(game, sprite,
+                     (int)x * game->tile_width + x_offset, (int)y * game->tile_height + y_offset,
+                     game->tile_width, game->tile_height);
 }
 
 static void
-game_mark_erased_square(
-    game_info_type *game,
-    bool erase_tiles[BOARD_HEIGHT][BOARD_WIDTH],
-    int mid_x,
-    int mid_y,
-    uint8_t *enemies_erased,
-    uint8_t *ships_erased)
+game_draw_tile_outline(SDL_Renderer         *renderer,
+                       const game_info_type *game,
+                       coord_type            coords)
 {
-    for (int x = MAX(mid_x - 1, 0); x < BOARD_WIDTH && x <= mid_x + 1; x++) {
-        for (int y = MAX(mid_y - 1, 0); y < BOARD_HEIGHT && y <= mid_y + 1; y++) {
-            erase_tiles[x][y] = true;
-
-            if (enemies_erased != NULL && game->tiles[x][y] == TILE_ENEMY) {
-                *enemies_erased += 1;
-            }
-            if (ships_erased != NULL && game->tiles[x][y] == TILE_SHIP) {
-                *ships_erased += 1;
-            }
-        }
-    }
+    SDL_Rect rect;
 
+    SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+    rect.x = (int)coords.x * game->tile_width;
+    rect.y = (int)coords.y * game->tile_height;
+    rect.w = game->tile_width;
+    rect.h = game->tile_height;
+    SDL_RenderDrawRect(renderer, &rect);
 }
 
-static void
-game_check_shot(game_info_type *game,
-                bool erase_tiles[BOARD_HEIGHT][BOARD_WIDTH],
-                size_t start_x,
-                size_t start_y,
-                bool *updated,
-                uint8_t *enemies_killed,
-                uint8_t *ships_killed)
+// Whether tiles are falling in a column, so it's drawn live rather than
+// from the retained board.
+static bool
+game_column_moving(const game_info_type *game,
+                   size_t x)
 {
     size_t y;
-    tile_type org_tile = game->tiles[start_x][start_y];
-    tile_type prev_tile = org_tile;
-    tile_type cur_tile;
-
 
-    if (org_tile != TILE_ENEMY && org_tile != TILE_BOMB) {
-        // This isn't a shootable thing.
-        return;
+    if (game->game_state != GAME_STATE_DROPPING) {
+        return false;
     }
 
-    if (start_y >= BOARD_HEIGHT - 2) {
-        // Not enough space on the board for shooting.
-        return;
+    for (y = 0; y < game->sim.height; y++) {
+        if (game->falls[sim_index(&game->sim, x, y)] > 0) {
+            return true;
+        }
     }
 
-    for (y = start_y + 1; y < BOARD_HEIGHT; y++) {
-        cur_tile = game->tiles[start_x][y];
-        if (org_tile == TILE_ENEMY && cur_tile == TILE_SHIP && prev_tile == TILE_LASER) {
-            // Player shoots enemy.
-            game_mark_erased(erase_tiles, start_x, start_y, 0, 1, y - start_y - 1);
-            *enemies_killed += 1;
-            *updated = true;
-        } else if (org_tile == TILE_ENEMY && cur_tile == TILE_SHIP && prev_tile == TILE_ENEMY_LASER) {
-            // Enemy shoots player.
-            game_mark_erased(erase_tiles, start_x, start_y + 1, 0, 1, y - start_y);
-            *ships_killed += 1;
-            *updated = true;
-        } else if (org_tile == TILE_ENEMY && cur_tile == TILE_BOMB && prev_tile == TILE_ENEMY_LASER) {
-            // Enemy shoots bomb.
-            game_mark_erased(erase_tiles, start_x, start_y + 1, 0, 1, y - start_y);
-            // We don't count an enemy killing an enemy to the score.
-            game_mark_erased_square(game, erase_tiles, start_x, y, NULL, ships_killed);
-            *updated = true;
-        } else if (org_tile == TILE_BOMB && cur_tile == TILE_SHIP && prev_tile == TILE_LASER) {
-            // Player shoots bomb.
-            game_mark_erased(erase_tiles, start_x, start_y, 0, 1, y - start_y);
-            game_mark_erased_square(game, erase_tiles, start_x, start_y, enemies_killed, ships_killed);
-            *updated = true;
-        } else if ((cur_tile != TILE_LASER || prev_tile == TILE_ENEMY_LASER) &&
-            (cur_tile != TILE_ENEMY_LASER || prev_tile == TILE_LASER)) {
-            // If this isn't valid run of laser fire, stop searching.
-            break;
-        }
+    return false;
+}
 
-        prev_tile = cur_tile;
-    }
+static bool
+game_cell_moving(const game_info_type *game,
+                 size_t x,
+                 size_t y,
+                 bool column_moving)
+{
+    return column_moving ||
+           (game->game_state == GAME_STATE_SWAPPING &&
+            ((game->swap_a.x == x && game->swap_a.y == y) || (game->swap_b.x == x && game->swap_b.y == y)));
 }
 
+// Forget what the retained board holds, so it's all drawn again.
 static void
-game_check_match(game_info_type *game,
-                 bool erase_tiles[BOARD_HEIGHT][BOARD_WIDTH],
-                 size_t start_x,
-                 size_t start_y,
-                 size_t x_inc,
-                 size_t y_inc,
-                 bool *updated)
+game_board_invalidate(game_info_type *game)
 {
-    tile_type orig = game->tiles[start_x][start_y];
-    tile_type prev = orig;
-    tile_type cur;
-    size_t x;
-    size_t y;
-    size_t distance = 0;
-
-    for (x = start_x + x_inc, y = start_y + y_inc; x < BOARD_WIDTH && y < BOARD_HEIGHT; x += x_inc, y += y_inc) {
-        cur = game->tiles[x][y];
-        distance = x - start_x + y - start_y;
-
-        if (cur != prev) {
-            if (distance > 2) {
-                game_mark_erased(erase_tiles, start_x, start_y, x_inc, y_inc, distance - 1);
-                game->energy = MIN(MAX_ENERGY, game->energy + (distance - 1) * MATCH_ENERGY);
-                *updated = true;
-            }
-            break;
-        }
-
-        prev = cur;
-    }
-
-    // If we stopped because we hit the end of the board, check if we had found a match before stopping.
-    if ((x == BOARD_WIDTH || y == BOARD_HEIGHT) && prev == orig && distance > 1) {
-        game_mark_erased(erase_tiles, start_x, start_y, x_inc, y_inc, distance);
-        game->energy = MIN(MAX_ENERGY, game->energy + distance * MATCH_ENERGY);
-        *updated = true;
+    if (game->board_tiles != NULL) {
+        memset(game->board_tiles, BOARD_TILE_UNKNOWN, game->sim.width * game->sim.height);
     }
+    game->board_settled = false;
 }
 
+// Draw the cells that have changed since the last frame into the retained
+// board. Moving cells are left empty, to be drawn live over the top.
 static void
-game_check_board(game_info_type *game,
-                 bool play_sounds)
+game_board_update(SDL_Renderer *renderer,
+                  game_info_type *game,
+                  atlas_handle atlas)
 {
-    bool erase_tiles[BOARD_HEIGHT][BOARD_WIDTH] = { 0 };
+    SDL_Rect rect;
+    tile_type tile;
     size_t x;
     size_t y;
-    bool updated;
-    bool found_match = false;
-    uint8_t enemies_killed = 0;
-    uint8_t ships_killed = 0;
-    
-    // Check for shots landing.
-    updated = false;
-    for (x = 0; x < BOARD_WIDTH; x++) {
-        for (y = 0; y < BOARD_HEIGHT; y++) {
-            game_check_shot(game, erase_tiles, x, y, &updated, &enemies_killed, &ships_killed);
-        }
+    size_t index;
+    bool column_moving;
+    bool drawing = false;
+    bool settled = game->game_state == GAME_STATE_IDLE;
+
+    // Nothing has changed if the board was drawn at rest and the sim hasn't
+    // been touched since.
+    if (settled && game->board_settled && game->board_changes == game->sim.changes) {
+        return;
     }
 
-    if (play_sounds && enemies_killed > 0) {
-        Mix_PlayChannel(-1, game->shoot_sound, 0);
-    }
-    if (play_sounds && ships_killed > 0) {
-        Mix_PlayChannel(-1, game->enemy_shoot_sound, 0);
-    }
+    for (x = 0; x < game->sim.width; x++) {
+        column_moving = game_column_moving(game, x);
+        for (y = 0; y < game->sim.height; y++) {
+            index = sim_index(&game->sim, x, y);
+            tile = game_cell_moving(game, x, y, column_moving) ? TILE_EMPTY : sim_tile(&game->sim, x, y);
+            if (game->board_tiles[index] == tile) {
+                continue;
+            }
 
-    // TODO: More points/energy for kills from further away?
-    game->score += (enemies_killed * enemies_killed) * game->chain * 100;
-    game->energy += enemies_killed * KILL_ENERGY;
-    game_lose_energy(game, ships_killed * DIE_ENERGY);
-    game->energy = MIN(MAX_ENERGY, game->energy);
-
-    // Check for matching runs.
-    for (x = 0; x < BOARD_WIDTH; x++) {
-        for (y = 0; y < BOARD_HEIGHT; y++) {
-            game_check_match(game, erase_tiles, x, y, 1, 0, &found_match);
-            game_check_match(game, erase_tiles, x, y, 0, 1, &found_match);
-        }
-    }
-    if (play_sounds && found_match) {
-        Mix_PlayChannel(-1, game->match_sound, 0);
-    }
-    updated = updated || found_match;
-
-    // Mark-and-sweep the tiles so that if there are multiple matches/shots involving the same tiles
-    // we get them all.
-    for (x = 0; x < BOARD_WIDTH; x++) {
-        for (y = 0; y < BOARD_HEIGHT; y++) {
-            if (erase_tiles[x][y]) {
-                game->tiles[x][y] = TILE_EMPTY;
+            if (!drawing) {
+                (void)SDL_SetRenderTarget(renderer, game->board);
+                SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+                drawing = true;
+            }
+
+            // Clear the cell to the window's background, then draw the tile.
+            rect.x = (int)x * game->tile_width;
+            rect.y = (int)y * game->tile_height;
+            rect.w = game->tile_width;
+            rect.h = game->tile_height;
+            SDL_RenderFillRect(renderer, &rect);
+            if (tile != TILE_EMPTY) {
+                game_draw_tile_textured(game, game_tile_sprites[tile], x, y, 0, 0);
             }
+
+            game->board_tiles[index] = (uint8_t)tile;
         }
     }
 
-    if (updated) {
-        game->game_state = GAME_STATE_DROPPING;
-        game->update_time = game->game_time;
+    if (drawing) {
+        atlas_flush(atlas, renderer);
+        (void)SDL_SetRenderTarget(renderer, NULL);
     }
+
+    game->board_changes = game->sim.changes;
+    game->board_settled = settled;
+}
+
+static coord_type
+game_window_coords_to_tile (const game_info_type *game, int32_t x, int32_t y)
+{
+    coord_type res;
+    res.x = x / game->tile_width;
+    res.y = y / game->tile_height;
+    return res;
 }
 
 static void
@@ -376,141 +339,85 @@ game_swap_tiles(game_info_type *game, coord_type a, coord_type b)
 {
     game->swap_a = a;
     game->swap_b = b;
+    game->hint_shown = false;
     game->game_state = GAME_STATE_SWAPPING;
-    game->update_time = game->game_time;
+    game->update_ticks = game->game_ticks;
 
-    Mix_PlayChannel(-1, game->swap_sound, 0);
+    game_play_sound(game->swap_sound);
 }
 
-static tile_type
-game_random_tile(void)
+static void
+game_start_drop(game_info_type *game)
 {
-    unsigned int index = random_range(0, sizeof(tile_weights) / sizeof(*tile_weights) - 1);
-    return tile_weights[index];
+    game->drop_rows = sim_drop(&game->sim, game->falls);
+    game->game_state = GAME_STATE_DROPPING;
+    game->update_ticks = game->game_ticks;
 }
 
 static void
 game_update(gamestate_mgr_handle mgr,
-            float frametime,
             game_info_type *game)
 {
-    size_t x;
-    int y;
-    bool dropping;
-    bool finished;
-
-    game->game_time += frametime;
+    game->game_ticks++;
 
-    if (game->game_time > game->tick_time + ENERGY_TICK_TIME) {
-        game_lose_energy(game, TICK_ENERGY);
-        game->tick_time = game->game_time;
+    if (game->game_ticks > game->energy_ticks + ENERGY_TICKS) {
+        sim_lose_energy(&game->sim, TICK_ENERGY);
+        game->energy_ticks = game->game_ticks;
     }
 
-    if (game->energy == 0) {
+    if (game->sim.energy == 0) {
         gamestate_push(mgr, gameover_init(game->renderer));
     }
 
-    if (game->game_state == GAME_STATE_SWAPPING && game->game_time > game->update_time + SWAP_TIME) {
-        tile_type tmp = game->tiles[game->swap_a.x][game->swap_a.y];
-        game->tiles[game->swap_a.x][game->swap_a.y] = game->tiles[game->swap_b.x][game->swap_b.y];
-        game->tiles[game->swap_b.x][game->swap_b.y] = tmp;
+    if (game->game_state == GAME_STATE_SWAPPING && game->game_ticks > game->update_ticks + SWAP_TICKS) {
+        PROFILE_BEGIN(apply_move, "game.check_board");
         game->game_state = GAME_STATE_IDLE;
-        game_check_board(game, true);
-        
-        // Lose the energy for moving after checking the board, so that if the player has less
-        // energy than it takes to move, they can avoid dying if they make a move that gains
-        // energy.
-        game_lose_energy(game, MOVE_ENERGY);
-    }
-    
-    if (game->game_state == GAME_STATE_DROPPING && game->game_time > game->update_time + DROP_TIME) {
-        // Move tiles down.
-        for (x = 0; x < BOARD_WIDTH; x++) {
-            dropping = false;
-            for (y = BOARD_HEIGHT - 1; y >= 0; y--) {
-                if (game->tiles[x][y] == TILE_EMPTY) {
-                    dropping = true;
-                }
-
-                if (dropping) {
-                    if (y == 0) {
-                        game->tiles[x][y] = game->next_row[x];
-                    } else {
-                        game->tiles[x][y] = game->tiles[x][y - 1];
-                    }
-                }
-            }
-        }
-
-        // Generate a new next row.
-        for (x = 0; x < BOARD_WIDTH; x++) {
-            game->next_row[x] = game_random_tile();
-        }
-
-        // Check if there is more movement to be done.
-        finished = true;
-        for (x = 0; finished && x < BOARD_WIDTH; x++) {
-            for (y = 0; finished && y < BOARD_HEIGHT; y++) {
-                if (game->tiles[x][y] == TILE_EMPTY) {
-                    game->update_time = game->game_time;
-                    finished = false;
-                }
-            }
+        if (sim_apply_move(&game->sim, game->swap_a, game->swap_b)) {
+            game_start_drop(game);
         }
+        PROFILE_END(apply_move);
+    }
 
-        // If we've finished moving, check if there are new matches.
-        if (finished) {
+    // The tiles have already dropped in the sim, so wait for them to land
+    // on screen, falling a row every DROP_TICKS, before checking for matches.
+    if (game->game_state == GAME_STATE_DROPPING &&
+        game->game_ticks > game->update_ticks + game->drop_rows * DROP_TICKS) {
+        PROFILE_BEGIN(settle, "game.cascade");
+        // Keep dropping until the board settles with no new matches.
+        if (sim_settle(&game->sim)) {
+            game_start_drop(game);
+        } else {
             game->game_state = GAME_STATE_IDLE;
-            
-            game_check_board(game, true);
-            
-            // If we found new matches, increase the chain, otherwise reset it.
-            if (game->game_state == GAME_STATE_DROPPING) {
-                game->chain += 1;
-            } else {
-                game->chain = 1;
-            }
         }
+        PROFILE_END(settle);
     }
    
 }
 
+// Draw a bar from its left, mid and right sprites, starting with sprite.
 static void
-game_draw_hud_bar(SDL_Renderer *renderer,
+game_draw_hud_bar(const game_info_type *game,
                   int y,
                   int height,
                   int start,
                   int end,
-                  SDL_Texture *left_texture,
-                  SDL_Texture *mid_texture,
-                  SDL_Texture *right_texture)
+                  game_sprite_type sprite)
 {
-    SDL_Rect rect;
     int i;
 
-    rect.x = start;
-    rect.y = y;
-    rect.w = 8;
-    rect.h = height;
-    SDL_RenderCopy(renderer, left_texture, NULL, &rect);
-
-    rect.x = MAX(end - 8, start + 8);
-    SDL_RenderCopy(renderer, right_texture, NULL, &rect);
+    game_draw_sprite(game, sprite, start, y, 8, height);
+    game_draw_sprite(game, sprite + 2, MAX(end - 8, start + 8), y, 8, height);
 
     const int mid_start = start + 8;
     const int mid_width = end - start - 16;
     const int mid_chunks = mid_width / 24;
     const int mid_remainder = mid_width - mid_chunks * 24;
 
-    rect.w = 24;
     for (i = 0; i < mid_chunks; i++) {
-        rect.x = mid_start + i * 24;
-        SDL_RenderCopy(renderer, mid_texture, NULL, &rect);
+        game_draw_sprite(game, sprite + 1, mid_start + i * 24, y, 24, height);
     }
 
-    rect.x = mid_start + i * 24;
-    rect.w = mid_remainder;
-    SDL_RenderCopy(renderer, mid_texture, NULL, &rect);
+    game_draw_sprite(game, sprite + 1, mid_start + i * 24, y, mid_remainder, height);
 }
 
 static void
@@ -518,140 +425,136 @@ game_draw_hud(SDL_Renderer *renderer,
               const game_info_type *game)
 {
     float energy_ratio;
-    SDL_Texture *energy_left;
-    SDL_Texture *energy_mid;
-    SDL_Texture *energy_right;
-    int y = 6;
+    game_sprite_type energy_sprite;
+    uint64_t total_seconds;
     int minutes;
     int seconds;
 
-    mapped_font_draw(renderer, game->hud_font, HUD_START_X, y, "Energy");
-    
-    y += HUD_TEXT_HEIGHT;
-    game_draw_hud_bar(renderer, y, HUD_BAR_HEIGHT, HUD_START_X, HUD_START_X + HUD_WIDTH,
-                      game->energy_bar_back_left, game->energy_bar_back_mid, game->energy_bar_back_right);
+    game_draw_hud_bar(game, HUD_ENERGY_BAR_Y, HUD_BAR_HEIGHT, HUD_START_X, HUD_START_X + HUD_WIDTH, GAME_SPRITE_ENERGY_BAR_BACK);
 
-    energy_ratio = (float)game->energy / (float)MAX_ENERGY;
+    energy_ratio = (float)game->sim.energy / (float)MAX_ENERGY;
     if (energy_ratio > 0.66f) {
-        energy_left = game->energy_bar_left;
-        energy_mid = game->energy_bar_mid;
-        energy_right = game->energy_bar_right;
+        energy_sprite = GAME_SPRITE_ENERGY_BAR;
     } else if (energy_ratio > 0.33f) {
-        energy_left = game->energy_bar_yellow_left;
-        energy_mid = game->energy_bar_yellow_mid;
-        energy_right = game->energy_bar_yellow_right;
+        energy_sprite = GAME_SPRITE_ENERGY_BAR_YELLOW;
     } else {
-        energy_left = game->energy_bar_red_left;
-        energy_mid = game->energy_bar_red_mid;
-        energy_right = game->energy_bar_red_right;
+        energy_sprite = GAME_SPRITE_ENERGY_BAR_RED;
     }
 
-    game_draw_hud_bar(renderer, y, HUD_BAR_HEIGHT, HUD_START_X, (int)(HUD_START_X + HUD_WIDTH * energy_ratio),
-                      energy_left, energy_mid, energy_right);
+    game_draw_hud_bar(game, HUD_ENERGY_BAR_Y, HUD_BAR_HEIGHT, HUD_START_X, (int)(HUD_START_X + HUD_WIDTH * energy_ratio),
+                      energy_sprite);
 
-    y += HUD_BAR_HEIGHT + HUD_TEXT_HEIGHT;
-    mapped_font_draw(renderer, game->hud_font, HUD_START_X, y, "Score");
-    y += HUD_TEXT_HEIGHT;
-    mapped_font_drawf_ex(renderer, game->hud_font_large, main_screen_width() - 4, y, ALIGN_RIGHT, "%u", game->score);
+    total_seconds = game->game_ticks / GAMESTATE_TICK_RATE;
+    minutes = (int)(total_seconds / 60);
+    seconds = (int)(total_seconds % 60);
+    mapped_text_setf(game->score_text, game->sim.score, "%u", game->sim.score);
+    mapped_text_setf(game->time_text, total_seconds, "%d:%02d", minutes, seconds);
 
-    y += HUD_TEXT_LARGE_HEIGHT;
-    mapped_font_draw(renderer, game->hud_font, HUD_START_X, y, "Time");
-    y += HUD_TEXT_HEIGHT;
+    mapped_text_queue(game->energy_label);
+    mapped_text_queue(game->score_label);
+    mapped_text_queue(game->time_label);
+    mapped_text_queue(game->score_text);
+    mapped_text_queue(game->time_text);
 
-    minutes = (int)game->game_time / 60;
-    seconds = (int)game->game_time - minutes * 60;
-    mapped_font_drawf_ex(renderer, game->hud_font_large, main_screen_width() - 4, y, ALIGN_RIGHT, "%d:%02d", minutes, seconds);
+    // All the text goes out in one call per font.
+    mapped_font_flush(renderer, game->hud_font);
+    mapped_font_flush(renderer, game->hud_font_large);
 
 }
 
+// Not const, as the retained board is brought up to date as it's drawn.
 static void
-game_draw(SDL_Renderer         *renderer,
-          const game_info_type *game)
+game_draw(SDL_Renderer   *renderer,
+          float           alpha,
+          game_info_type *game)
 {
+    atlas_handle atlas = asset_atlas(game->atlas);
+    SDL_Rect board_rect;
     tile_type tile;
     size_t x;
-    int y;
+    size_t y;
     int y_offset;
-    int x_offset = 0;
-    int swap_distance;
+    int x_offset;
+    float swap_progress;
+    float rows_left;
+    float update_ticks;
+    bool column_moving;
+
+    // Drawn first, as it has to go out before anything else is queued in
+    // the atlas.
+    if (game->board != NULL && atlas != NULL) {
+        PROFILE_BEGIN(board, "game.board");
+        game_board_update(renderer, game, atlas);
+        PROFILE_END(board);
+        board_rect.x = 0;
+        board_rect.y = 0;
+        board_rect.w = (int)game->sim.width * game->tile_width;
+        board_rect.h = (int)game->sim.height * game->tile_height;
+        SDL_RenderCopy(renderer, game->board, NULL, &board_rect);
+    }
 
     game_draw_hud(renderer, game);
 
-    for (x = 0; x < BOARD_HEIGHT; x++) {
-        y_offset = 0;
-        for (y = BOARD_HEIGHT - 1; y >= -1; y--) {
-            // Draw the next row dropping in if required.
-            if (y < 0) {
-                if (y_offset != 0) {
-                    tile = game->next_row[x];
-                } else {
-                    break;
+    // Ticks since the swap or drop started, as of this frame, so tiles move
+    // smoothly between ticks.
+    update_ticks = (float)(game->game_ticks - game->update_ticks) + alpha;
+
+    // With a retained board only moving tiles are drawn here, and at rest
+    // there are none.
+    if (game->board == NULL || game->game_state != GAME_STATE_IDLE) {
+        for (x = 0; x < game->sim.width; x++) {
+            column_moving = game_column_moving(game, x);
+            for (y = game->sim.height; y-- > 0;) {
+                // Still tiles are on the retained board already.
+                if (game->board != NULL && !game_cell_moving(game, x, y, column_moving)) {
+                    continue;
                 }
-            } else {
-                tile = game->tiles[x][y];
-            }
 
-            // If we're swapping tiles, draw them moving.
-            if (game->game_state == GAME_STATE_SWAPPING) {
+                tile = sim_tile(&game->sim, x, y);
                 x_offset = 0;
                 y_offset = 0;
-                swap_distance = (int)(((game->game_time - game->update_time) / DROP_TIME) * TILE_HEIGHT);
-                if (game->swap_a.x == x && game->swap_a.y == y) {
-                    x_offset = swap_distance * (game->swap_b.x - game->swap_a.x);
-                    y_offset = swap_distance * (game->swap_b.y - game->swap_a.y);
-                } else if (game->swap_b.x == x && game->swap_b.y == y) {
-                    x_offset = swap_distance * (game->swap_a.x - game->swap_b.x);
-                    y_offset = swap_distance * (game->swap_a.y - game->swap_b.y);
-                }
-            }
-
-            switch (tile) {
-            case TILE_SHIP:
-                game_draw_tile_textured(renderer, game->ship_texture, x, y, x_offset, y_offset);
-                break;
-
-            case TILE_LASER:
-                game_draw_tile_textured(renderer, game->laser_texture, x, y, x_offset, y_offset);
-                break;
-
-            case TILE_ENEMY_LASER:
-                game_draw_tile_textured(renderer, game->enemy_laser_texture, x, y, x_offset, y_offset);
-                break;
-
-            case TILE_ENEMY:
-                game_draw_tile_textured(renderer, game->enemy_texture, x, y, x_offset, y_offset);
-                break;
-
-            case TILE_BOMB:
-                game_draw_tile_textured(renderer, game->bomb_texture, x, y, x_offset, y_offset);
-                break;
-
-            case TILE_ASTEROID_1:
-                game_draw_tile_textured(renderer, game->asteroid_1_texture, x, y, x_offset, y_offset);
-                break;
 
-            case TILE_ASTEROID_2:
-                game_draw_tile_textured(renderer, game->asteroid_2_texture, x, y, x_offset, y_offset);
-                break;
-
-            case TILE_ASTEROID_3:
-                game_draw_tile_textured(renderer, game->asteroid_3_texture, x, y, x_offset, y_offset);
-                break;
+                // If we're dropping, draw the tiles that haven't landed yet above
+                // where they'll end up.
+                if (game->game_state == GAME_STATE_DROPPING) {
+                    rows_left = game->falls[sim_index(&game->sim, x, y)] - update_ticks / DROP_TICKS;
+                    if (rows_left > 0.0f) {
+                        y_offset = -(int)(rows_left * game->tile_height);
+                    }
+                }
 
-            case TILE_EMPTY:
-                // An empty tile means that the tiles above will be dropping, calculate the offset.
-                // This should only happen in dropping state - we don't want to be swapping and dropping
-                // at the same time else the offsets will be messed up.
-                assert(game->game_state == GAME_STATE_DROPPING);
-                y_offset = (int)(((game->game_time - game->update_time) / DROP_TIME) * TILE_HEIGHT);
-                break;
+                // If we're swapping tiles, draw them moving.
+                if (game->game_state == GAME_STATE_SWAPPING) {
+                    swap_progress = MIN(update_ticks / SWAP_TICKS, 1.0f);
+                    if (game->swap_a.x == x && game->swap_a.y == y) {
+                        x_offset = (int)(swap_progress * game->tile_width) * ((int)game->swap_b.x - (int)game->swap_a.x);
+                        y_offset = (int)(swap_progress * game->tile_height) * ((int)game->swap_b.y - (int)game->swap_a.y);
+                    } else if (game->swap_b.x == x && game->swap_b.y == y) {
+                        x_offset = (int)(swap_progress * game->tile_width) * ((int)game->swap_a.x - (int)game->swap_b.x);
+                        y_offset = (int)(swap_progress * game->tile_height) * ((int)game->swap_a.y - (int)game->swap_b.y);
+                    }
+                }
 
-            default:
-                assert(!"Unknown tile type");
+                // Gaps are filled as soon as they're cleared, so there's
+                // nothing to draw for them.
+                assert(tile <= TILE_EMPTY && "Unknown tile type");
+                if (tile != TILE_EMPTY) {
+                    game_draw_tile_textured(game, game_tile_sprites[tile], x, y, x_offset, y_offset);
+                }
             }
         }
     }
 
+    // The HUD bars and the whole board go out in one call.
+    if (asset_atlas(game->atlas) != NULL) {
+        atlas_flush(asset_atlas(game->atlas), renderer);
+    }
+
+    if (game->hint_shown) {
+        game_draw_tile_outline(renderer, game, game->hint.a);
+        game_draw_tile_outline(renderer, game, game->hint.b);
+    }
+
 }
 
 static void
@@ -663,12 +566,19 @@ game_event(gamestate_mgr_handle mgr,
 
     switch (e->type) {
     case SDL_MOUSEBUTTONDOWN:
-        game->mouse_down_coords = game_window_coords_to_tile(e->button.x, e->button.y);
+        game->mouse_down_coords = game_window_coords_to_tile(game, e->button.x, e->button.y);
         break;
 
     case SDL_MOUSEBUTTONUP:
         if (game->game_state == GAME_STATE_IDLE) {
-            up_coords = game_window_coords_to_tile(e->button.x, e->button.y);
+            up_coords = game_window_coords_to_tile(game, e->button.x, e->button.y);
+
+            // Ignore drags that start or end off the board, e.g. over the HUD.
+            if (up_coords.x >= game->sim.width || up_coords.y >= game->sim.height ||
+                game->mouse_down_coords.x >= game->sim.width || game->mouse_down_coords.y >= game->sim.height) {
+                break;
+            }
+
             if ((up_coords.y == game->mouse_down_coords.y + 1 && up_coords.x == game->mouse_down_coords.x) ||
                 (up_coords.y == game->mouse_down_coords.y - 1 && up_coords.x == game->mouse_down_coords.x) ||
                 (up_coords.x == game->mouse_down_coords.x + 1 && up_coords.y == game->mouse_down_coords.y) ||
@@ -677,6 +587,39 @@ game_event(gamestate_mgr_handle mgr,
             }
         }
         break;
+
+    case SDL_RENDER_TARGETS_RESET:
+    case SDL_RENDER_DEVICE_RESET:
+        // The retained board's contents were lost.
+        game_board_invalidate(game);
+        break;
+
+    case SDL_KEYDOWN:
+        // Show the move that does the most right now, if there is one.
+        if (e->key.keysym.sym == SDLK_h && game->game_state == GAME_STATE_IDLE) {
+            game->hint_shown = move_best(&game->sim, &game->hint, NULL);
+        }
+        break;
+    }
+}
+
+
+static void
+game_sim_event(sim_event_type  event,
+               game_info_type *game)
+{
+    switch (event) {
+    case SIM_EVENT_SHOOT:
+        game_play_sound(game->shoot_sound);
+        break;
+
+    case SIM_EVENT_ENEMY_SHOOT:
+        game_play_sound(game->enemy_shoot_sound);
+        break;
+
+    case SIM_EVENT_MATCH:
+        game_play_sound(game->match_sound);
+        break;
     }
 }
 
@@ -684,119 +627,115 @@ game_event(gamestate_mgr_handle mgr,
 static void
 game_cleanup(game_info_type *game)
 {
-    Mix_FreeChunk(game->match_sound);
-    Mix_FreeChunk(game->enemy_shoot_sound);
-    Mix_FreeChunk(game->shoot_sound);
-    Mix_FreeChunk(game->swap_sound);
-
-    free_texture(game->energy_bar_red_left);
-    free_texture(game->energy_bar_red_mid);
-    free_texture(game->energy_bar_red_right);
-    free_texture(game->energy_bar_yellow_left);
-    free_texture(game->energy_bar_yellow_mid);
-    free_texture(game->energy_bar_yellow_right);
-    free_texture(game->energy_bar_back_left);
-    free_texture(game->energy_bar_back_mid);
-    free_texture(game->energy_bar_back_right);
-    free_texture(game->energy_bar_left);
-    free_texture(game->energy_bar_mid);
-    free_texture(game->energy_bar_right);
-    free_texture(game->enemy_laser_texture);
-    free_texture(game->laser_texture);
-    free_texture(game->bomb_texture);
-    free_texture(game->asteroid_3_texture);
-    free_texture(game->asteroid_2_texture);
-    free_texture(game->asteroid_1_texture);
-    free_texture(game->enemy_texture);
-    free_texture(game->ship_texture);
-
-    mapped_font_destroy(game->hud_font_large);
-    mapped_font_destroy(game->hud_font);
+    // The assets stay cached for the next game.
+    asset_release(game->match_sound);
+    asset_release(game->enemy_shoot_sound);
+    asset_release(game->shoot_sound);
+    asset_release(game->swap_sound);
 
+    asset_release(game->atlas);
+
+    if (game->board != NULL) {
+        SDL_DestroyTexture(game->board);
+    }
+    free(game->board_tiles);
+
+    mapped_text_destroy(game->time_text);
+    mapped_text_destroy(game->score_text);
+    mapped_text_destroy(game->time_label);
+    mapped_text_destroy(game->score_label);
+    mapped_text_destroy(game->energy_label);
+    mapped_font_release(game->hud_font_large);
+    mapped_font_release(game->hud_font);
+
+    sim_destroy(&game->sim);
+    free(game->falls);
     free(game);
 }
 
 
 gamestate_type
-game_init(SDL_Renderer *renderer)
+game_init(SDL_Renderer *renderer,
+          uint64_t      seed)
 {
-    gamestate_type gamestate;
+    gamestate_type gamestate = { 0 };
     game_info_type *game;
-    bool updated;
-    size_t x;
-    size_t y;
+    PROFILE_BEGIN(init, "game.init");
 
     game = calloc(1, sizeof(*game));
+    if (game == NULL) {
+        PROFILE_END(init);
+        return gamestate;
+    }
     game->renderer = renderer;
 
     // Load media
-    game->hud_font = mapped_font_create(renderer, "media/fonts/hud.ttf", HUD_TEXT_HEIGHT);
-    game->hud_font_large = mapped_font_create(renderer, "media/fonts/hud.ttf", HUD_TEXT_LARGE_HEIGHT);
-
-    game->ship_texture = load_texture("media/textures/player.png", renderer);
-    game->enemy_texture = load_texture("media/textures/enemyShip.png", renderer);
-    game->asteroid_1_texture = load_texture("media/textures/asteroid_1.png", renderer);
-    game->asteroid_2_texture = load_texture("media/textures/asteroid_2.png", renderer);
-    game->asteroid_3_texture = load_texture("media/textures/asteroid_3.png", renderer);
-    game->bomb_texture = load_texture("media/textures/enemyUFO.png", renderer);
-    game->laser_texture = load_texture("media/textures/laser.png", renderer);   
-    game->enemy_laser_texture = load_texture("media/textures/enemyLaser.png", renderer);
-    game->energy_bar_left = load_texture("media/textures/energy_left.png", renderer);
-    game->energy_bar_mid = load_texture("media/textures/energy_mid.png", renderer);
-    game->energy_bar_right = load_texture("media/textures/energy_right.png", renderer);
-    game->energy_bar_back_left = load_texture("media/textures/energy_back_left.png", renderer);
-    game->energy_bar_back_mid = load_texture("media/textures/energy_back_mid.png", renderer);
-    game->energy_bar_back_right = load_texture("media/textures/energy_back_right.png", renderer);
-    game->energy_bar_yellow_left = load_texture("media/textures/energy_yellow_left.png", renderer);
-    game->energy_bar_yellow_mid = load_texture("media/textures/energy_yellow_mid.png", renderer);
-    game->energy_bar_yellow_right = load_texture("media/textures/energy_yellow_right.png", renderer);
-    game->energy_bar_red_left = load_texture("media/textures/energy_red_left.png", renderer);
-    game->energy_bar_red_mid = load_texture("media/textures/energy_red_mid.png", renderer);
-    game->energy_bar_red_right = load_texture("media/textures/energy_red_right.png", renderer);
-
-    game->swap_sound = Mix_LoadWAV("media/sounds/swap.ogg");
-    game->shoot_sound = Mix_LoadWAV("media/sounds/shoot.ogg");
-    game->enemy_shoot_sound = Mix_LoadWAV("media/sounds/enemy_shoot.ogg");
-    game->match_sound = Mix_LoadWAV("media/sounds/match.ogg");
-
-    // Set up board.
-    for (x = 0; x < BOARD_WIDTH; x++) {
-        game->next_row[x] = game_random_tile();
-
-        for (y = 0; y < BOARD_HEIGHT; y++) {
-            game->tiles[x][y] = game_random_tile();
-        }
+    game->hud_font = mapped_font_acquire(renderer, "media/fonts/hud.ttf", HUD_TEXT_HEIGHT);
+    game->hud_font_large = mapped_font_acquire(renderer, "media/fonts/hud.ttf", HUD_TEXT_LARGE_HEIGHT);
+
+    game->energy_label = mapped_text_create(game->hud_font, HUD_START_X, HUD_TOP, color_white, ALIGN_LEFT);
+    game->score_label = mapped_text_create(game->hud_font, HUD_START_X, HUD_SCORE_LABEL_Y, color_white, ALIGN_LEFT);
+    game->time_label = mapped_text_create(game->hud_font, HUD_START_X, HUD_TIME_LABEL_Y, color_white, ALIGN_LEFT);
+    game->score_text = mapped_text_create(game->hud_font_large, main_screen_width() - 4, HUD_SCORE_Y, color_white, ALIGN_RIGHT);
+    game->time_text = mapped_text_create(game->hud_font_large, main_screen_width() - 4, HUD_TIME_Y, color_white, ALIGN_RIGHT);
+    mapped_text_set(game->energy_label, "Energy");
+    mapped_text_set(game->score_label, "Score");
+    mapped_text_set(game->time_label, "Time");
+
+    game->atlas = asset_atlas_acquire(renderer, game_sprite_files, GAME_SPRITE_COUNT);
+    game->swap_sound = asset_sound_acquire("media/sounds/swap.ogg");
+    game->shoot_sound = asset_sound_acquire("media/sounds/shoot.ogg");
+    game->enemy_shoot_sound = asset_sound_acquire("media/sounds/enemy_shoot.ogg");
+    game->match_sound = asset_sound_acquire("media/sounds/match.ogg");
+
+    // Fall back to the usual board if the one asked for can't be set up.
+    if (!sim_init(&game->sim, main_board_width(), main_board_height(), seed, (sim_event_fn_type)&game_sim_event, game) &&
+        !sim_init(&game->sim, DEFAULT_BOARD_WIDTH, DEFAULT_BOARD_HEIGHT, seed, (sim_event_fn_type)&game_sim_event, game)) {
+        game_cleanup(game);
+        PROFILE_END(init);
+        return gamestate;
+    }
+    game->falls = calloc(game->sim.width * game->sim.height, sizeof(*game->falls));
+    if (game->falls == NULL) {
+        game_cleanup(game);
+        PROFILE_END(init);
+        return gamestate;
     }
 
-    do {
-        updated = false;
-
-        // Check for matches
-        game_check_board(game, false);
+    // Huge boards get a pixel per tile, even if that runs off the square.
+    game->tile_width = MAX(BOARD_PIXELS / (int)game->sim.width, 1);
+    game->tile_height = MAX(BOARD_PIXELS / (int)game->sim.height, 1);
 
-        // Fill in any gaps.
-        for (x = 0; x < BOARD_WIDTH; x++) {
-            for (y = 0; y < BOARD_HEIGHT; y++) {
-                if (game->tiles[x][y] == TILE_EMPTY) {
-                    updated = true;
-                    game->tiles[x][y] = game_random_tile();
-                }
+    game->game_state = GAME_STATE_IDLE;
+    game->energy_ticks = ENERGY_TICKS;
+
+    // Keep the board drawn in a texture if the renderer can, so frames only
+    // draw the tiles that have changed. Everything is drawn the first time.
+    if (SDL_RenderTargetSupported(renderer)) {
+        game->board = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                        (int)game->sim.width * game->tile_width,
+                                        (int)game->sim.height * game->tile_height);
+        game->board_tiles = malloc(game->sim.width * game->sim.height);
+        if (game->board == NULL || game->board_tiles == NULL) {
+            if (game->board != NULL) {
+                SDL_DestroyTexture(game->board);
+                game->board = NULL;
             }
+            free(game->board_tiles);
+            game->board_tiles = NULL;
         }
-    } while (updated);
-    
-    game->chain = 1;
-    game->score = 0;
-    game->game_state = GAME_STATE_IDLE;
-    game->energy = MAX_ENERGY;
-    game->tick_time = ENERGY_TICK_TIME;
+        game_board_invalidate(game);
+    }
 
     gamestate.update_cb = (gamestate_update_fn_type)&game_update;
     gamestate.draw_cb = (gamestate_draw_fn_type)&game_draw;
     gamestate.event_cb = (gamestate_event_fn_type)&game_event;
     gamestate.cleanup_cb = (gamestate_cleanup_fn_type)&game_cleanup;
+    gamestate.idle_cb = NULL;
     gamestate.flags = GAMESTATE_FLAG_DEFAULT;
+    gamestate.name = "game";
     gamestate.ctx = game;
 
+    PROFILE_END(init);
     return gamestate;
 }
\ No newline at end of file
@@ -1,9 +1,11 @@
 #ifndef __GAME_H__
 #define __GAME_H__
 
+#include <stdint.h>
 #include <SDL.h>
 #include "gamestate.h"
 
-gamestate_type game_init(SDL_Renderer *renderer);
+// The state's ctx is NULL if the game couldn't be set up.
+gamestate_type game_init(SDL_Renderer *renderer, uint64_t seed);
 
 #endif __GAME_H__
\ No newline at end of file
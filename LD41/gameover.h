@@ -12,39 +12,47 @@
 
 #define BIG_FONT_SIZE 128
 #define SMALL_FONT_SIZE 64
-#define PAUSE_TIME 1.0f
+#define PAUSE_TICKS GAMESTATE_TICKS(1.0)
 
 typedef struct gameover_info {
     mapped_font_handle big_font;
     mapped_font_handle small_font;
+    mapped_text_handle title_text;
+    mapped_text_handle continue_text;
     SDL_Renderer *renderer; // Hang on to this for creating new gamestates.
-    float time;
+    uint64_t ticks;
 } gameover_info_type;
 
 static inline void
 gameover_update(gamestate_mgr_handle mgr,
-                float frametime,
                 gameover_info_type *gameover)
 {
-    gameover->time += frametime;
+    gameover->ticks++;
 }
 
 static inline void
 gameover_draw(SDL_Renderer *renderer,
+              float alpha,
               const gameover_info_type *gameover)
 {
-    int center = main_screen_width() / 2;
-
     draw_overlay(renderer, main_screen_width(), main_screen_height());
 
-    mapped_font_draw_ex(renderer, gameover->big_font, center, SMALL_FONT_SIZE, 0, 0, 0, color_white, ALIGN_CENTER, "Game Over!");
+    mapped_text_queue(gameover->title_text);
+    mapped_font_flush(renderer, gameover->big_font);
  
-    if (gameover->time > PAUSE_TIME) {
-        mapped_font_draw_ex(renderer, gameover->small_font, center, main_screen_height() - SMALL_FONT_SIZE * 2, 0, 0, 0,
-                            color_white, ALIGN_CENTER, "Press any key to continue");
+    if (gameover->ticks > PAUSE_TICKS) {
+        mapped_text_queue(gameover->continue_text);
+        mapped_font_flush(renderer, gameover->small_font);
     }
 }
 
+static inline uint64_t
+gameover_idle(const gameover_info_type *gameover)
+{
+    // Nothing moves until the prompt to continue appears.
+    return gameover->ticks > PAUSE_TICKS ? GAMESTATE_IDLE_FOREVER : PAUSE_TICKS + 1 - gameover->ticks;
+}
+
 static inline void
 gameover_event(gamestate_mgr_handle mgr,
                SDL_Event *e,
@@ -57,10 +65,15 @@ gameover_event(gamestate_mgr_handle mgr,
     switch (e->type) {
     case SDL_KEYDOWN:
     case SDL_MOUSEBUTTONUP:
-        if (gameover->time > PAUSE_TIME) {
+        if (gameover->ticks > PAUSE_TICKS) {
             // Calling gamestate_replace_all will free this gamestate,
             // so do anything that needs access to it up front.
-            new_game = game_init(gameover->renderer);
+            new_game = game_init(gameover->renderer, main_game_seed());
+            if (new_game.ctx == NULL) {
+                // Stay on this screen, a key can try again.
+                SDL_Log("Failed to start a new game");
+                break;
+            }
             new_menu = menu_main_init(gameover->renderer);
 
             gamestate_replace_all(mgr, new_game);
@@ -73,8 +86,10 @@ gameover_event(gamestate_mgr_handle mgr,
 static void
 gameover_cleanup(gameover_info_type *gameover)
 {
-    mapped_font_destroy(gameover->small_font);
-    mapped_font_destroy(gameover->big_font);
+    mapped_text_destroy(gameover->continue_text);
+    mapped_text_destroy(gameover->title_text);
+    mapped_font_release(gameover->small_font);
+    mapped_font_release(gameover->big_font);
     free(gameover);
 }
 
@@ -82,19 +97,29 @@ static inline gamestate_type
 gameover_init(SDL_Renderer *renderer) {
     gamestate_type gamestate;
     gameover_info_type *gameover;
+    int center = main_screen_width() / 2;
+    PROFILE_BEGIN(init, "gameover.init");
 
     gameover = calloc(1, sizeof(*gameover));
     gameover->renderer = renderer;
-    gameover->big_font = mapped_font_create(renderer, "media/fonts/hud.ttf", BIG_FONT_SIZE);
-    gameover->small_font = mapped_font_create(renderer, "media/fonts/hud.ttf", SMALL_FONT_SIZE);
+    gameover->big_font = mapped_font_acquire(renderer, "media/fonts/hud.ttf", BIG_FONT_SIZE);
+    gameover->small_font = mapped_font_acquire(renderer, "media/fonts/hud.ttf", SMALL_FONT_SIZE);
+    gameover->title_text = mapped_text_create(gameover->big_font, center, SMALL_FONT_SIZE, color_white, ALIGN_CENTER);
+    gameover->continue_text = mapped_text_create(gameover->small_font, center, main_screen_height() - SMALL_FONT_SIZE * 2,
+                                                 color_white, ALIGN_CENTER);
+    mapped_text_set(gameover->title_text, "Game Over!");
+    mapped_text_set(gameover->continue_text, "Press any key to continue");
     
     gamestate.update_cb = (gamestate_update_fn_type)&gameover_update;
     gamestate.draw_cb = (gamestate_draw_fn_type)&gameover_draw;
     gamestate.event_cb = (gamestate_event_fn_type)&gameover_event;
     gamestate.cleanup_cb = (gamestate_cleanup_fn_type)&gameover_cleanup;
+    gamestate.idle_cb = (gamestate_idle_fn_type)&gameover_idle;
     gamestate.flags = GAMESTATE_FLAG_DRAW_UNDER;
+    gamestate.name = "gameover";
     gamestate.ctx = gameover;
 
+    PROFILE_END(init);
     return gamestate;
 }
 
@@ -1,13 +1,31 @@
 #include <assert.h>
+#include <stdio.h>
 #include <SDL.h>
 #include "gamestate.h"
+#include "platform.h"
+#include "profile.h"
 
 #define GAMESTATE_TOP(_mgr) (&(_mgr)->gamestate_stack[(_mgr)->gamestate_count - 1])
 
+static void
+gamestate_profile_zones(gamestate_type *state)
+{
+    char name[PROFILE_NAME_LENGTH];
+
+    (void)snprintf(name, sizeof(name), "%s.event", state->name);
+    state->event_zone = profile_zone(name);
+    (void)snprintf(name, sizeof(name), "%s.update", state->name);
+    state->update_zone = profile_zone(name);
+    (void)snprintf(name, sizeof(name), "%s.draw", state->name);
+    state->draw_zone = profile_zone(name);
+}
+
+
 void
 gamestate_push(gamestate_mgr_type *mgr, gamestate_type state)
 {
     assert(mgr->gamestate_count < MAX_GAMESTATES);
+    gamestate_profile_zones(&state);
     mgr->gamestate_stack[mgr->gamestate_count++] = state;
 }
 
@@ -16,6 +34,7 @@ void
 gamestate_replace(gamestate_mgr_type *mgr, gamestate_type state)
 {
     gamestate_type *top = GAMESTATE_TOP(mgr);
+    gamestate_profile_zones(&state);
     top->cleanup_cb(top->ctx);
     *top = state;
 }
@@ -24,6 +43,7 @@ gamestate_replace(gamestate_mgr_type *mgr, gamestate_type state)
 void
 gamestate_replace_all(gamestate_mgr_type *mgr, gamestate_type state)
 {
+    gamestate_profile_zones(&state);
     for (size_t i = 0; i < mgr->gamestate_count; i++) {
         gamestate_type *state = &mgr->gamestate_stack[i];
         state->cleanup_cb(state->ctx);
@@ -46,29 +66,62 @@ void
 gamestate_event(SDL_Event *e, gamestate_mgr_type *mgr)
 {
     gamestate_type *state = GAMESTATE_TOP(mgr);
+    profile_zone_type zone = state->event_zone;
+    uint64_t start;
+
+    // Every state is told when render targets are lost, as states under the
+    // top one can hold them too.
+    if (e->type == SDL_RENDER_TARGETS_RESET || e->type == SDL_RENDER_DEVICE_RESET) {
+        for (size_t i = 0; i + 1 < mgr->gamestate_count; i++) {
+            mgr->gamestate_stack[i].event_cb(mgr, e, mgr->gamestate_stack[i].ctx);
+        }
+    }
+
+    // The callback may replace the state, so its zone is noted first.
+    start = platform_time_ns();
     state->event_cb(mgr, e, state->ctx);
+    profile_end(zone, start);
 }
 
 
 void
-gamestate_update(float frametime, gamestate_mgr_type *mgr)
+gamestate_update(gamestate_mgr_type *mgr)
 {
     gamestate_type *state = GAMESTATE_TOP(mgr);
-    state->update_cb(mgr, frametime, state->ctx);
+    profile_zone_type zone = state->update_zone;
+    uint64_t start = platform_time_ns();
+
+    state->update_cb(mgr, state->ctx);
+    profile_end(zone, start);
 }
 
 
 void
-gamestate_draw(SDL_Renderer *renderer, const gamestate_mgr_type *mgr)
+gamestate_draw(SDL_Renderer *renderer, float alpha, const gamestate_mgr_type *mgr)
 {
     const gamestate_type *state = GAMESTATE_TOP(mgr);
     gamestate_type *under;
+    uint64_t start;
 
     // Note this only supports a single layer of drawing under.
     if ((state->flags & GAMESTATE_FLAG_DRAW_UNDER) != 0 && mgr->gamestate_count > 1) {
         under = &mgr->gamestate_stack[mgr->gamestate_count - 2];
-        under->draw_cb(renderer, under->ctx);
+        start = platform_time_ns();
+        under->draw_cb(renderer, alpha, under->ctx);
+        profile_end(under->draw_zone, start);
     }
 
-    state->draw_cb(renderer, state->ctx);
-}
\ No newline at end of file
+    start = platform_time_ns();
+    state->draw_cb(renderer, alpha, state->ctx);
+    profile_end(state->draw_zone, start);
+}
+
+
+uint64_t
+gamestate_idle(const gamestate_mgr_type *mgr)
+{
+    const gamestate_type *state = GAMESTATE_TOP(mgr);
+
+    // States under the top one don't update, so only the top one counts.
+    return state->idle_cb != NULL ? state->idle_cb(state->ctx) : 0;
+}
@@ -2,22 +2,39 @@
 #define __GAMESTATE_H__
 
 
+#include <stdint.h>
 #include <SDL.h>
 
+#include "profile.h"
+
 
 #define MAX_GAMESTATES 16
 
+// States update in fixed ticks, however fast frames are drawn, so the game
+// plays the same at any frame rate. Times are kept in whole ticks.
+#define GAMESTATE_TICK_RATE 120
+#define GAMESTATE_TICKS(seconds) ((uint64_t)((seconds) * GAMESTATE_TICK_RATE + 0.5))
+
 typedef struct gamestate_mgr *gamestate_mgr_handle;
 
 typedef void(*gamestate_event_fn_type)(gamestate_mgr_handle mgr,
                                        SDL_Event *e,
                                        void      *ctx);
+// Advance one tick.
 typedef void(*gamestate_update_fn_type)(gamestate_mgr_handle mgr,
-                                        float frametime,
                                         void *ctx);
+// Draw alpha (0 to 1) of the way from the last tick to the next, so motion
+// is smooth when frames come faster than ticks.
 typedef void(*gamestate_draw_fn_type)(SDL_Renderer *renderer,
+                                      float         alpha,
                                       void         *ctx);
 typedef void(*gamestate_cleanup_fn_type)(void *ctx);
+// How many ticks the state can go without updating or drawing if no input
+// comes in, e.g. a menu waiting for a key. States with a NULL idle_cb are
+// always busy.
+typedef uint64_t(*gamestate_idle_fn_type)(const void *ctx);
+
+#define GAMESTATE_IDLE_FOREVER UINT64_MAX
 
 typedef uint8_t gamestate_flag_type;
 #define GAMESTATE_FLAG_DEFAULT    0x00
@@ -28,8 +45,13 @@ typedef struct gamestate {
     gamestate_update_fn_type  update_cb;
     gamestate_draw_fn_type    draw_cb;
     gamestate_cleanup_fn_type cleanup_cb;
+    gamestate_idle_fn_type    idle_cb;
     void                     *ctx;
     gamestate_flag_type       flags;
+    const char               *name;        // What the profiler times the callbacks as, e.g. "game.draw".
+    profile_zone_type         event_zone;  // Filled in when the state is pushed.
+    profile_zone_type         update_zone;
+    profile_zone_type         draw_zone;
 } gamestate_type;
 
 typedef struct gamestate_mgr {
@@ -42,8 +64,9 @@ void gamestate_replace(gamestate_mgr_type *mgr, gamestate_type state);
 void gamestate_replace_all(gamestate_mgr_type *mgr, gamestate_type state);
 void gamestate_pop(gamestate_mgr_type *mgr);
 void gamestate_event(SDL_Event *e, gamestate_mgr_type *mgr);
-void gamestate_update(float frametime, gamestate_mgr_type *mgr);
-void gamestate_draw(SDL_Renderer *renderer, const gamestate_mgr_type *mgr);
+void gamestate_update(gamestate_mgr_type *mgr);
+void gamestate_draw(SDL_Renderer *renderer, float alpha, const gamestate_mgr_type *mgr);
+uint64_t gamestate_idle(const gamestate_mgr_type *mgr);
 
 
 #endif /* __GAMESTATE_H__ */
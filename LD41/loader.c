@@ -0,0 +1,170 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "loader.h"
+#include "platform.h"
+#include "task_pool.h"
+
+typedef struct loader_job {
+    loader_fn_type     decode;
+    loader_fn_type     upload;
+    void              *ctx;
+    struct loader_job *next;
+} loader_job_type;
+
+static task_pool_handle      loader_pool = NULL;
+static platform_mutex_handle loader_lock = NULL; // Protects the list of decoded jobs.
+static loader_job_type      *loader_decoded_head = NULL;
+static loader_job_type      *loader_decoded_tail = NULL;
+static size_t                loader_pending = 0; // Jobs not yet uploaded. Main thread only.
+
+
+static void
+loader_decode(loader_job_type *job)
+{
+    job->decode(job->ctx);
+
+    platform_mutex_lock(loader_lock);
+    job->next = NULL;
+    if (loader_decoded_tail != NULL) {
+        loader_decoded_tail->next = job;
+    } else {
+        loader_decoded_head = job;
+    }
+    loader_decoded_tail = job;
+    platform_mutex_unlock(loader_lock);
+}
+
+
+static loader_job_type *
+loader_take_decoded(void)
+{
+    loader_job_type *job;
+
+    platform_mutex_lock(loader_lock);
+    job = loader_decoded_head;
+    if (job != NULL) {
+        loader_decoded_head = job->next;
+        if (loader_decoded_head == NULL) {
+            loader_decoded_tail = NULL;
+        }
+    }
+    platform_mutex_unlock(loader_lock);
+
+    return job;
+}
+
+
+/*
+ * See loader.h for details.
+ */
+void
+loader_start(unsigned int threads)
+{
+    if (loader_pool == NULL) {
+        loader_lock = platform_mutex_create();
+        loader_pool = task_pool_create(threads);
+
+        // Without the threads, everything loads as it's submitted.
+        if (loader_lock == NULL || loader_pool == NULL) {
+            if (loader_pool != NULL) {
+                task_pool_destroy(loader_pool);
+            }
+            if (loader_lock != NULL) {
+                platform_mutex_destroy(loader_lock);
+            }
+            loader_pool = NULL;
+            loader_lock = NULL;
+        }
+    }
+}
+
+
+/*
+ * See loader.h for details.
+ */
+void
+loader_stop(void)
+{
+    if (loader_pool != NULL) {
+        task_pool_wait(loader_pool);
+        loader_update(UINT64_MAX);
+
+        task_pool_destroy(loader_pool);
+        platform_mutex_destroy(loader_lock);
+        loader_pool = NULL;
+        loader_lock = NULL;
+    }
+}
+
+
+/*
+ * See loader.h for details.
+ */
+void
+loader_submit(loader_fn_type  decode,
+              loader_fn_type  upload,
+              void           *ctx)
+{
+    loader_job_type *job = NULL;
+
+    if (loader_pool != NULL) {
+        job = malloc(sizeof(*job));
+    }
+
+    if (job == NULL) {
+        decode(ctx);
+        upload(ctx);
+        return;
+    }
+
+    job->decode = decode;
+    job->upload = upload;
+    job->ctx = ctx;
+    if (!task_pool_submit(loader_pool, (task_fn_type)&loader_decode, job)) {
+        free(job);
+        decode(ctx);
+        upload(ctx);
+        return;
+    }
+    loader_pending++;
+}
+
+
+/*
+ * See loader.h for details.
+ */
+void
+loader_update(uint64_t budget_ns)
+{
+    loader_job_type *job;
+    uint64_t         start;
+
+    if (loader_pending == 0) {
+        return;
+    }
+
+    start = platform_time_ns();
+    do {
+        job = loader_take_decoded();
+        if (job == NULL) {
+            break;
+        }
+
+        job->upload(job->ctx);
+        free(job);
+        loader_pending--;
+    } while (platform_time_ns() - start < budget_ns);
+}
+
+
+/*
+ * See loader.h for details.
+ */
+bool
+loader_busy(void)
+{
+    return loader_pending > 0;
+}
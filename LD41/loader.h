@@ -0,0 +1,51 @@
+#ifndef __LOADER_H__
+#define __LOADER_H__
+
+
+/*
+ * Background loading. Each job is split in two: a decode step (reading and
+ * decoding files into surfaces, PCM and the like) that runs on a worker
+ * thread, and an upload step (anything touching the renderer) that runs on
+ * the main thread in loader_update, a few per frame, so nothing blocks a
+ * frame for long.
+ *
+ * Until loader_start is called, and after loader_stop, jobs run straight
+ * through on the calling thread. So do jobs that can't be handed to a
+ * thread, e.g. for lack of memory.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef void(*loader_fn_type)(void *ctx);
+
+
+/*
+ * Start decoding on the given number of worker threads.
+ */
+void loader_start(unsigned int threads);
+
+/*
+ * Finish every outstanding job, then go back to loading synchronously.
+ */
+void loader_stop(void);
+
+/*
+ * Queue a job. decode must only touch ctx and thread-safe library calls;
+ * upload runs on the main thread after decode has finished.
+ */
+void loader_submit(loader_fn_type decode, loader_fn_type upload, void *ctx);
+
+/*
+ * Run the upload step of finished jobs until budget_ns has passed. At least
+ * one job is uploaded if any are ready, so loading always makes progress.
+ */
+void loader_update(uint64_t budget_ns);
+
+/*
+ * Whether any submitted job hasn't been uploaded yet.
+ */
+bool loader_busy(void);
+
+
+#endif /* __LOADER_H__ */
@@ -1,19 +1,61 @@
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
 
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_mixer.h>
 #include <SDL2/SDL_ttf.h>
 
+#include "asset.h"
+#include "font.h"
 #include "game.h"
 #include "gamestate.h"
+#include "loader.h"
+#include "main.h"
 #include "menu_main.h"
+#include "pack.h"
+#include "pacing.h"
+#include "platform.h"
+#include "profile.h"
+#include "random.h"
+#include "sim.h"
+#include "utils.h"
 
 #define SCREEN_WIDTH 1280
 #define SCREEN_HEIGHT 800
 
+// Pre-baked media, built by LD41Pack. Loose files are used without it.
+#define MEDIA_PACK "media/media.pack"
+
+// Time each frame may spend uploading loaded assets to the renderer.
+#define LOADER_FRAME_BUDGET_NS 2000000
+
+// Most ticks a frame runs to catch up, so a long stall (e.g. the window
+// being dragged) doesn't leave the game fast forwarding.
+#define MAX_CATCH_UP_TICKS 30
+
+// Where the profile is written on exit, unless set with -profile. In the
+// user's pref path.
+#define PROFILE_CSV "profile.csv"
+
+// Frames longer than this get any trace being written out straight away.
+// Two frames at 60 Hz, so a single late frame doesn't.
+#define TRACE_BUDGET_MS 33
+
+// Shows and hides the profiler overlay.
+#define PROFILE_OVERLAY_KEY SDLK_F3
+
+// Frames are capped at this rate, unless set with -fps (0 for uncapped) or
+// paced by vsync instead.
+#define DEFAULT_FPS 60
+
+static random_state_type main_random;
+static size_t main_board_width_value = DEFAULT_BOARD_WIDTH;
+static size_t main_board_height_value = DEFAULT_BOARD_HEIGHT;
+
 unsigned int
 main_screen_width(void)
 {
@@ -26,18 +68,71 @@ main_screen_height(void)
     return SCREEN_HEIGHT;
 }
 
+size_t
+main_board_width(void)
+{
+    return main_board_width_value;
+}
+
+size_t
+main_board_height(void)
+{
+    return main_board_height_value;
+}
+
+uint64_t
+main_game_seed(void)
+{
+    return random_next(&main_random);
+}
+
+/*
+ * Read a board size given as WIDTHxHEIGHT, keeping the default if it isn't
+ * one the sim supports.
+ */
+static void
+main_parse_board_size(const char *text)
+{
+    char          *end;
+    unsigned long  width = strtoul(text, &end, 10);
+    unsigned long  height = *end == 'x' ? strtoul(end + 1, NULL, 10) : 0;
+
+    if (width > 0 && width <= MAX_BOARD_SIZE && height > 0 && height <= MAX_BOARD_SIZE && width * height >= 2) {
+        main_board_width_value = width;
+        main_board_height_value = height;
+    }
+}
+
 int main(int argc, char* argv[])
 {
     SDL_Window         *window;
     SDL_Renderer       *renderer;
     SDL_Event           e;
     bool                run = true;
-    float               last_ticks = 0.0f;
-    float               ticks;
-    float               frametime;
+    Uint64              frequency;
+    Uint64              last_counter;
+    Uint64              counter;
+    Uint64              accumulator = 0;
+    float               alpha;
+    unsigned int        fps = DEFAULT_FPS;
+    bool                vsync = false;
+    bool                idle = true;
+    uint64_t            idle_ticks;
+    profile_zone_type   frame_zone;
+    uint64_t            frame_start;
+    SDL_RendererInfo    renderer_info;
+    pacing_type         pacing;
+    bool                have_event;
+    const char         *profile_csv = NULL;
+    const char         *trace = NULL;
+    uint64_t            trace_budget_ms = TRACE_BUDGET_MS;
+    char               *pref_path;
+    char                profile_path[FILENAME_MAX];
     gamestate_mgr_type  gamestate_mgr = { 0 };
-
-    srand(time(NULL));
+    gamestate_type      game;
+    bool                seeded = false;
+    int                 arg;
+    unsigned int        cpus;
 
     (void)SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
     (void)IMG_Init(IMG_INIT_PNG);
@@ -45,25 +140,110 @@ int main(int argc, char* argv[])
     (void)Mix_Init(MIX_INIT_OGG);
     (void)Mix_OpenAudio(MIX_DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT, 2, 1024);
 
+    // Games are seeded from the clock, unless a seed is given with -seed so
+    // that a run can be replayed. -board sets the board size, e.g. for
+    // stress testing with a huge board. -fps, -vsync 1 and -idle 0 change
+    // how frames are paced, and -profile where the profile is written.
+    // -trace writes a trace of startup and every frame, flushed whenever a
+    // frame runs over -trace_budget milliseconds.
+    for (arg = 1; arg + 1 < argc; arg += 2) {
+        if (strcmp(argv[arg], "-seed") == 0) {
+            random_seed(&main_random, strtoull(argv[arg + 1], NULL, 10));
+            seeded = true;
+        } else if (strcmp(argv[arg], "-board") == 0) {
+            main_parse_board_size(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "-fps") == 0) {
+            fps = (unsigned int)strtoul(argv[arg + 1], NULL, 10);
+        } else if (strcmp(argv[arg], "-vsync") == 0) {
+            vsync = atoi(argv[arg + 1]) != 0;
+        } else if (strcmp(argv[arg], "-idle") == 0) {
+            idle = atoi(argv[arg + 1]) != 0;
+        } else if (strcmp(argv[arg], "-profile") == 0) {
+            profile_csv = argv[arg + 1];
+        } else if (strcmp(argv[arg], "-trace") == 0) {
+            trace = argv[arg + 1];
+        } else if (strcmp(argv[arg], "-trace_budget") == 0) {
+            trace_budget_ms = strtoull(argv[arg + 1], NULL, 10);
+        }
+    }
+
+    // Opened before the window and the media, so the trace covers startup.
+    if (trace != NULL && !profile_trace_open(trace, trace_budget_ms * 1000000)) {
+        SDL_Log("Failed to open the trace %s", trace);
+        trace = NULL;
+    }
+    if (!seeded) {
+        random_seed(&main_random, SDL_GetPerformanceCounter());
+    }
+
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "2");
     window = SDL_CreateWindow("LD41",
                               SDL_WINDOWPOS_UNDEFINED,
                               SDL_WINDOWPOS_UNDEFINED,
                               SCREEN_WIDTH, SCREEN_HEIGHT,
                               SDL_WINDOW_SHOWN);
-    renderer = SDL_CreateRenderer(window, -1, 0);
+    renderer = SDL_CreateRenderer(window, -1, vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
     (void)SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
-    gamestate_push(&gamestate_mgr, game_init(renderer));
-    gamestate_push(&gamestate_mgr, menu_main_init(renderer));
+    // Presenting waits for vsync if the renderer managed to turn it on, so
+    // there's no need to pace frames as well.
+    if (SDL_GetRendererInfo(renderer, &renderer_info) == 0 && (renderer_info.flags & SDL_RENDERER_PRESENTVSYNC) != 0) {
+        fps = 0;
+    }
+
+    (void)pack_open(MEDIA_PACK);
+
+    // Assets decode in the background on every core but the main thread's,
+    // so the menu is up straight away while the game's media streams in.
+    cpus = platform_cpu_count();
+    loader_start(cpus > 1 ? cpus - 1 : 1);
+
+    game = game_init(renderer, main_game_seed());
+    if (game.ctx != NULL) {
+        gamestate_push(&gamestate_mgr, game);
+        gamestate_push(&gamestate_mgr, menu_main_init(renderer));
+    } else {
+        SDL_Log("Failed to start the game");
+        run = false;
+    }
+
+    // Time is accumulated in performance counter units times the tick rate,
+    // so a tick is exactly frequency units and nothing is lost to rounding
+    // however long the game runs.
+    frequency = SDL_GetPerformanceFrequency();
+    last_counter = SDL_GetPerformanceCounter();
+    pacing_init(&pacing, fps);
+    frame_zone = profile_zone("frame");
 
     while (run) {
-        while (SDL_PollEvent(&e)) {
+        // When nothing is moving or loading, sleep until there's input or
+        // the state next has something to do, rather than redrawing the same
+        // frame. Waits are kept short enough that the ticks missed can all
+        // be caught up.
+        idle_ticks = idle && !loader_busy() ? gamestate_idle(&gamestate_mgr) : 0;
+        if (idle_ticks > 0) {
+            have_event = SDL_WaitEventTimeout(&e, (int)(MIN(idle_ticks, MAX_CATCH_UP_TICKS) * 1000 / GAMESTATE_TICK_RATE));
+        } else {
+            have_event = SDL_PollEvent(&e);
+        }
+
+        // Time spent waiting for input isn't part of the frame.
+        frame_start = platform_time_ns();
+
+        for (; have_event; have_event = SDL_PollEvent(&e)) {
             switch (e.type) {
             case SDL_QUIT:
                 run = false;
                 break;
 
+            case SDL_KEYDOWN:
+                if (e.key.keysym.sym == PROFILE_OVERLAY_KEY) {
+                    profile_toggle_overlay();
+                } else {
+                    gamestate_event(&e, &gamestate_mgr);
+                }
+                break;
+
             default:
                 gamestate_event(&e, &gamestate_mgr);
                 break;
@@ -72,24 +252,65 @@ int main(int argc, char* argv[])
 
         // TODO: quit if no gamestates active?
 
-        ticks = (float)SDL_GetTicks() / 1000.0f;
-        frametime = ticks - last_ticks;
-        last_ticks = ticks;
+        counter = SDL_GetPerformanceCounter();
+        accumulator += (counter - last_counter) * GAMESTATE_TICK_RATE;
+        accumulator = MIN(accumulator, frequency * MAX_CATCH_UP_TICKS);
+        last_counter = counter;
+
+        PROFILE_BEGIN(loader, "loader.update");
+        loader_update(LOADER_FRAME_BUDGET_NS);
+        PROFILE_END(loader);
+
+        while (accumulator >= frequency) {
+            gamestate_update(&gamestate_mgr);
+            accumulator -= frequency;
+        }
 
-        gamestate_update(frametime, &gamestate_mgr);
+        // Draw however far we are between the last tick and the next.
+        alpha = (float)((double)accumulator / (double)frequency);
 
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_RenderClear(renderer);
-        gamestate_draw(renderer, &gamestate_mgr);
+        gamestate_draw(renderer, alpha, &gamestate_mgr);
+        profile_draw(renderer);
+
+        PROFILE_BEGIN(present, "present");
         SDL_RenderPresent(renderer);
+        PROFILE_END(present);
+
+        profile_end(frame_zone, frame_start);
+        profile_frame(platform_time_ns() - frame_start);
+
+        pacing_wait(&pacing);
     }
 
     // TODO: gamestate cleanup
 
+    // Write the profile where it can be picked up from production machines.
+    if (profile_csv == NULL) {
+        pref_path = SDL_GetPrefPath("LD41", "LD41");
+        if (pref_path != NULL) {
+            (void)snprintf(profile_path, sizeof(profile_path), "%s%s", pref_path, PROFILE_CSV);
+            profile_csv = profile_path;
+            SDL_free(pref_path);
+        }
+    }
+    if (profile_csv != NULL && !profile_write_csv(profile_csv)) {
+        SDL_Log("Failed to write the profile to %s", profile_csv);
+    }
+    if (trace != NULL && !profile_trace_close()) {
+        SDL_Log("Failed to write the trace %s", trace);
+    }
+    profile_shutdown();
+
+    loader_stop();
+    mapped_font_cache_purge();
+    asset_cache_purge();
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
 
     Mix_CloseAudio();
+    pack_close();
     Mix_Quit();
     TTF_Quit();
     IMG_Quit();
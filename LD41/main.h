@@ -1,7 +1,21 @@
 #ifndef __MAIN_H__
 #define __MAIN_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
 unsigned int main_screen_width(void);
 unsigned int main_screen_height(void);
 
+/*
+ * The size of board to play on, set with -board WIDTHxHEIGHT.
+ */
+size_t main_board_width(void);
+size_t main_board_height(void);
+
+/*
+ * A seed for a new game, drawn from a stream seeded once at startup.
+ */
+uint64_t main_game_seed(void);
+
 #endif /* __MAIN_H__ */
@@ -0,0 +1,429 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcts.h"
+#include "move.h"
+#include "platform.h"
+#include "random.h"
+#include "sim.h"
+#include "task_pool.h"
+
+#define DEFAULT_ROLLOUTS 20000
+#define DEFAULT_ROLLOUT_DEPTH 10
+#define TREES_PER_THREAD 4
+
+// Rollouts a tree runs per task. Small enough that trees can be spread
+// across threads evenly, big enough that the scheduling cost is noise.
+#define MCTS_CHUNK 64
+
+// UCB1 exploration constant.
+#define MCTS_EXPLORATION 1.41421356
+
+#define MCTS_NO_NODE 0 // The root is never anyone's child.
+#define MCTS_NODE_FAILED UINT32_MAX
+#define MCTS_MAX_DEPTH 64
+
+typedef struct mcts_node {
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint32_t visits;
+    uint32_t move;   // Index into the move table of the move that led here.
+    uint32_t tried;  // How many of this node's moves have been expanded.
+    uint32_t offset; // Where in the move table this node starts expanding.
+    double   value;  // Sum of rollout rewards through this node.
+} mcts_node_type;
+
+typedef struct mcts_tree {
+    struct mcts       *mcts;
+    random_state_type  random;
+    sim_type           sim;       // Scratch board for rollouts.
+    mcts_node_type    *nodes;
+    size_t             node_count;
+    size_t             node_size;
+    uint64_t           rollouts;
+    uint64_t           chunk;     // Rollouts to run in the current task.
+} mcts_tree_type;
+
+typedef struct mcts {
+    mcts_config_type  config;
+    task_pool_handle  pool;
+    mcts_tree_type   *trees;
+    move_type        *moves;
+    size_t            move_count;
+    uint32_t         *visits;     // Root visits for each move, summed over the trees.
+    double           *values;
+    sim_type          root;
+    uint64_t          deadline;   // platform_time_ns() to stop at, or 0.
+    uint64_t          searches;
+} mcts_type;
+
+
+/*
+ * Add a node to the tree and return its index, or MCTS_NODE_FAILED if the
+ * tree can't grow.
+ */
+static uint32_t
+mcts_node_add(mcts_tree_type *tree,
+              uint32_t        move)
+{
+    mcts_node_type *node;
+    mcts_node_type *nodes;
+    size_t          size;
+
+    if (tree->node_count == tree->node_size) {
+        size = tree->node_size == 0 ? 1024 : tree->node_size * 2;
+        nodes = realloc(tree->nodes, size * sizeof(*tree->nodes));
+        if (nodes == NULL) {
+            return MCTS_NODE_FAILED;
+        }
+        tree->nodes = nodes;
+        tree->node_size = size;
+    }
+
+    node = &tree->nodes[tree->node_count];
+    node->first_child = MCTS_NO_NODE;
+    node->next_sibling = MCTS_NO_NODE;
+    node->visits = 0;
+    node->move = move;
+    node->tried = 0;
+    node->offset = random_range(&tree->random, 0, (unsigned int)tree->mcts->move_count - 1);
+    node->value = 0.0;
+
+    return (uint32_t)tree->node_count++;
+}
+
+
+static uint32_t
+mcts_select_child(const mcts_tree_type *tree,
+                  const mcts_node_type *parent)
+{
+    const mcts_node_type *child;
+    uint32_t              index;
+    uint32_t              best = MCTS_NO_NODE;
+    double                log_visits = log((double)parent->visits);
+    double                score;
+    double                best_score = -1.0;
+
+    for (index = parent->first_child; index != MCTS_NO_NODE; index = child->next_sibling) {
+        child = &tree->nodes[index];
+        score = child->value / child->visits + MCTS_EXPLORATION * sqrt(log_visits / child->visits);
+        if (score > best_score) {
+            best_score = score;
+            best = index;
+        }
+    }
+
+    return best;
+}
+
+
+static inline void
+mcts_play(sim_type        *sim,
+          const move_type *move)
+{
+    if (sim_apply_move(sim, move->a, move->b)) {
+        sim_resolve(sim);
+    }
+}
+
+
+/*
+ * One rollout: walk down the tree, expand a node, play on at random and
+ * feed the result back up the path.
+ */
+static void
+mcts_rollout(mcts_tree_type *tree)
+{
+    const mcts_type *mcts = tree->mcts;
+    sim_type        *sim = &tree->sim;
+    uint32_t         path[MCTS_MAX_DEPTH + 1];
+    size_t           depth = 0;
+    uint32_t         index = 0;
+    uint32_t         child;
+    unsigned int     played = 0;
+    unsigned int     horizon;
+    uint32_t         move;
+    double           reward;
+    size_t           i;
+
+    sim_copy(sim, &mcts->root);
+    random_seed(&sim->random, random_next(&tree->random));
+    path[depth++] = 0;
+
+    // Selection and expansion.
+    while (sim->energy > 0 && depth <= MCTS_MAX_DEPTH) {
+        if (tree->nodes[index].tried < mcts->move_count) {
+            // If the tree can't grow, play on at random from here instead.
+            move = (tree->nodes[index].offset + tree->nodes[index].tried) % mcts->move_count;
+            child = mcts_node_add(tree, move);
+            if (child == MCTS_NODE_FAILED) {
+                break;
+            }
+
+            tree->nodes[index].tried++;
+            tree->nodes[child].next_sibling = tree->nodes[index].first_child;
+            tree->nodes[index].first_child = child;
+
+            mcts_play(sim, &mcts->moves[move]);
+            played++;
+            path[depth++] = child;
+            break;
+        }
+
+        index = mcts_select_child(tree, &tree->nodes[index]);
+        mcts_play(sim, &mcts->moves[tree->nodes[index].move]);
+        played++;
+        path[depth++] = index;
+    }
+
+    // Simulation.
+    horizon = played + mcts->config.rollout_depth;
+    while (sim->energy > 0 && played < horizon) {
+        mcts_play(sim, &mcts->moves[random_range(&tree->random, 0, (unsigned int)mcts->move_count - 1)]);
+        played++;
+    }
+
+    // Surviving the horizon is always better than dying; after that, more
+    // energy in hand is better.
+    if (sim->energy > 0) {
+        reward = 0.5 + 0.5 * sim->energy / MAX_ENERGY;
+    } else {
+        reward = played > 0 ? 0.5 * (played - 1) / horizon : 0.0;
+    }
+
+    for (i = 0; i < depth; i++) {
+        tree->nodes[path[i]].visits++;
+        tree->nodes[path[i]].value += reward;
+    }
+}
+
+
+static void
+mcts_tree_task(mcts_tree_type *tree)
+{
+    uint64_t i;
+
+    for (i = 0; i < tree->chunk; i++) {
+        if (tree->mcts->deadline != 0 && platform_time_ns() >= tree->mcts->deadline) {
+            break;
+        }
+        mcts_rollout(tree);
+        tree->rollouts++;
+    }
+}
+
+
+/*
+ * See mcts.h for details.
+ */
+mcts_handle
+mcts_create(const mcts_config_type *config)
+{
+    mcts_handle mcts;
+
+    mcts = calloc(1, sizeof(*mcts));
+    if (mcts == NULL) {
+        return NULL;
+    }
+
+    mcts->config = *config;
+    mcts->pool = task_pool_create(config->threads);
+    if (mcts->pool == NULL) {
+        free(mcts);
+        return NULL;
+    }
+
+    if (mcts->config.trees == 0) {
+        mcts->config.trees = task_pool_threads(mcts->pool) * TREES_PER_THREAD;
+    }
+    if (mcts->config.rollouts == 0 && mcts->config.time_ms == 0) {
+        mcts->config.rollouts = DEFAULT_ROLLOUTS;
+    }
+    if (mcts->config.rollout_depth == 0) {
+        mcts->config.rollout_depth = DEFAULT_ROLLOUT_DEPTH;
+    }
+
+    mcts->trees = calloc(mcts->config.trees, sizeof(*mcts->trees));
+    if (mcts->trees == NULL) {
+        task_pool_destroy(mcts->pool);
+        free(mcts);
+        return NULL;
+    }
+
+    return mcts;
+}
+
+
+void
+mcts_destroy(mcts_handle mcts)
+{
+    unsigned int i;
+
+    task_pool_destroy(mcts->pool);
+    for (i = 0; i < mcts->config.trees; i++) {
+        free(mcts->trees[i].nodes);
+        sim_destroy(&mcts->trees[i].sim);
+    }
+    sim_destroy(&mcts->root);
+    free(mcts->trees);
+    free(mcts->moves);
+    free(mcts->visits);
+    free(mcts->values);
+    free(mcts);
+}
+
+
+/*
+ * Set up the root, the trees' scratch boards and the move table for a new
+ * board size. Returns false if they can't be allocated, leaving the root
+ * empty so the next search tries again.
+ */
+static bool
+mcts_prepare(mcts_handle     mcts,
+             const sim_type *sim)
+{
+    size_t        count = move_count(sim);
+    move_type    *moves;
+    uint32_t     *visits;
+    double       *values;
+    unsigned int  i;
+    bool          ok;
+
+    // Tables that do grow are kept, so they're freed with the player.
+    moves = realloc(mcts->moves, count * sizeof(*mcts->moves));
+    if (moves != NULL) {
+        mcts->moves = moves;
+    }
+    visits = realloc(mcts->visits, count * sizeof(*mcts->visits));
+    if (visits != NULL) {
+        mcts->visits = visits;
+    }
+    values = realloc(mcts->values, count * sizeof(*mcts->values));
+    if (values != NULL) {
+        mcts->values = values;
+    }
+
+    sim_destroy(&mcts->root);
+    ok = moves != NULL && visits != NULL && values != NULL && sim_clone(&mcts->root, sim);
+    for (i = 0; i < mcts->config.trees; i++) {
+        sim_destroy(&mcts->trees[i].sim);
+        ok = ok && sim_clone(&mcts->trees[i].sim, sim);
+    }
+
+    if (!ok) {
+        // A failed clone keeps the source's size, so it has to be cleared
+        // for the root not to look ready.
+        sim_destroy(&mcts->root);
+        for (i = 0; i < mcts->config.trees; i++) {
+            sim_destroy(&mcts->trees[i].sim);
+        }
+        mcts->move_count = 0;
+        return false;
+    }
+
+    mcts->move_count = count;
+    (void)move_generate(sim, mcts->moves);
+
+    return true;
+}
+
+
+/*
+ * See mcts.h for details.
+ */
+bool
+mcts_search(mcts_handle      mcts,
+            const sim_type  *sim,
+            move_type       *best,
+            mcts_stats_type *stats)
+{
+    mcts_tree_type *tree;
+    uint64_t        start = platform_time_ns();
+    uint64_t        tree_budget;
+    uint32_t       *visits;
+    double         *values;
+    uint32_t        index;
+    unsigned int    i;
+    unsigned int    busy;
+    size_t          best_move = 0;
+
+    if (mcts->root.width == sim->width && mcts->root.height == sim->height) {
+        sim_copy(&mcts->root, sim);
+    } else if (!mcts_prepare(mcts, sim)) {
+        return false;
+    }
+    mcts->root.event_cb = NULL;
+    visits = mcts->visits;
+    values = mcts->values;
+    memset(visits, 0, mcts->move_count * sizeof(*visits));
+    memset(values, 0, mcts->move_count * sizeof(*values));
+    mcts->deadline = mcts->config.time_ms != 0 ? start + mcts->config.time_ms * 1000000ULL : 0;
+    tree_budget = mcts->config.rollouts != 0 ?
+                  (mcts->config.rollouts + mcts->config.trees - 1) / mcts->config.trees :
+                  UINT64_MAX;
+
+    for (i = 0; i < mcts->config.trees; i++) {
+        tree = &mcts->trees[i];
+        tree->mcts = mcts;
+        tree->node_count = 0;
+        tree->rollouts = 0;
+        random_seed(&tree->random, mcts->config.seed ^ (mcts->searches << 32) ^ i);
+        if (mcts_node_add(tree, 0) == MCTS_NODE_FAILED) {
+            return false;
+        }
+    }
+    mcts->searches++;
+
+    // Run the trees a chunk at a time until the budget runs out.
+    do {
+        busy = 0;
+        for (i = 0; i < mcts->config.trees; i++) {
+            tree = &mcts->trees[i];
+            if (tree->rollouts < tree_budget) {
+                tree->chunk = tree_budget - tree->rollouts < MCTS_CHUNK ? tree_budget - tree->rollouts : MCTS_CHUNK;
+                // A chunk that can't be queued is run here instead. Trees
+                // are independent, so the results are the same.
+                if (!task_pool_submit(mcts->pool, (task_fn_type)&mcts_tree_task, tree)) {
+                    mcts_tree_task(tree);
+                }
+                busy++;
+            }
+        }
+        task_pool_wait(mcts->pool);
+    } while (busy > 0 && (mcts->deadline == 0 || platform_time_ns() < mcts->deadline));
+
+    // Combine the trees' root statistics in a fixed order, and take the
+    // most visited move.
+    if (stats != NULL) {
+        stats->rollouts = 0;
+        stats->nodes = 0;
+    }
+    for (i = 0; i < mcts->config.trees; i++) {
+        tree = &mcts->trees[i];
+        for (index = tree->nodes[0].first_child; index != MCTS_NO_NODE; index = tree->nodes[index].next_sibling) {
+            visits[tree->nodes[index].move] += tree->nodes[index].visits;
+            values[tree->nodes[index].move] += tree->nodes[index].value;
+        }
+        if (stats != NULL) {
+            stats->rollouts += tree->rollouts;
+            stats->nodes += tree->node_count;
+        }
+    }
+    for (i = 1; i < mcts->move_count; i++) {
+        if (visits[i] > visits[best_move] ||
+            (visits[i] == visits[best_move] && values[i] > values[best_move])) {
+            best_move = i;
+        }
+    }
+
+    *best = mcts->moves[best_move];
+    if (stats != NULL) {
+        stats->time_ns = platform_time_ns() - start;
+    }
+
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef __MCTS_H__
+#define __MCTS_H__
+
+
+/*
+ * Monte Carlo tree search player. The board refills at random, so the search
+ * is open-loop: each tree node stands for a sequence of moves, and every
+ * rollout replays the sequence from the root with fresh random refills.
+ *
+ * Several independent trees are searched in parallel on a task pool and
+ * their root statistics combined. Every tree draws from its own random
+ * stream, seeded from the config seed, so with a rollout budget (and no time
+ * budget) the same position, seed and number of trees always give the same
+ * move, whatever the thread count or scheduling.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "move.h"
+#include "sim.h"
+
+
+typedef struct mcts_config {
+    unsigned int threads;       // Worker threads, or 0 for one per core.
+    unsigned int trees;         // Independent trees, or 0 for four per thread.
+    uint64_t     rollouts;      // Rollouts per search, or 0 for no limit.
+    uint32_t     time_ms;       // Wall-clock time per search, or 0 for no limit.
+    unsigned int rollout_depth; // Random moves played after leaving the tree.
+    uint64_t     seed;
+} mcts_config_type;
+
+typedef struct mcts_stats {
+    uint64_t rollouts;
+    uint64_t nodes;
+    uint64_t time_ns;
+} mcts_stats_type;
+
+typedef struct mcts *mcts_handle;
+
+
+/*
+ * Create a player. If neither budget is set, a default rollout budget is
+ * used. Returns NULL if it can't be allocated.
+ */
+mcts_handle mcts_create(const mcts_config_type *config);
+void mcts_destroy(mcts_handle mcts);
+
+/*
+ * Pick a move for a settled board. stats may be NULL. Returns false, with no
+ * move picked, if the search can't be set up for the board, e.g. for lack of
+ * memory.
+ */
+bool mcts_search(mcts_handle mcts, const sim_type *sim, move_type *best, mcts_stats_type *stats);
+
+
+#endif /* __MCTS_H__ */
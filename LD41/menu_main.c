@@ -9,42 +9,49 @@
 #define BIG_FONT_SIZE 128
 #define SMALL_FONT_SIZE 64
 #define MINI_FONT_SIZE 24
-#define PAUSE_TIME 0.5f
+#define PAUSE_TICKS GAMESTATE_TICKS(0.5)
 
 typedef struct menu_main_info {
     mapped_font_handle big_font;
     mapped_font_handle small_font;
     mapped_font_handle mini_font;
+    mapped_text_handle title_text;
+    mapped_text_handle tutorial_text;
+    mapped_text_handle start_text;
+    mapped_text_handle credits_text;
     SDL_Renderer *renderer;
-    float time;
+    uint64_t ticks;
 } menu_main_info_type;
 
 static void
 menu_main_update(gamestate_mgr_handle mgr,
-                 float frametime,
                  menu_main_info_type *menu)
 {
-    menu->time += frametime;
+    menu->ticks++;
 }
 
 static void
 menu_main_draw(SDL_Renderer *renderer,
+               float alpha,
                const menu_main_info_type *menu)
 {
-    int y = SMALL_FONT_SIZE;
-    int center = main_screen_width() / 2;
-
     draw_overlay(renderer, main_screen_width(), main_screen_height());
 
-    mapped_font_draw_ex(renderer, menu->big_font, center, y, 0, 0, 0, color_white, ALIGN_CENTER, "LD41");
-    y += BIG_FONT_SIZE + SMALL_FONT_SIZE * 2;
+    mapped_text_queue(menu->title_text);
+    mapped_text_queue(menu->tutorial_text);
+    mapped_text_queue(menu->start_text);
+    mapped_text_queue(menu->credits_text);
 
-    mapped_font_draw_ex(renderer, menu->small_font, center, y, 0, 0, 0, color_white, ALIGN_CENTER, "Press T for tutorial");
-    y += SMALL_FONT_SIZE;
-    mapped_font_draw_ex(renderer, menu->small_font, center, y, 0, 0, 0, color_white, ALIGN_CENTER, "Or any other key to start");
+    mapped_font_flush(renderer, menu->big_font);
+    mapped_font_flush(renderer, menu->small_font);
+    mapped_font_flush(renderer, menu->mini_font);
+}
 
-    mapped_font_draw_ex(renderer, menu->mini_font, center, main_screen_height() - MINI_FONT_SIZE * 2, 0, 0, 0,
-                        color_white, ALIGN_CENTER, "Game by Juzley, Assets from kenney.nl");
+static uint64_t
+menu_main_idle(const menu_main_info_type *menu)
+{
+    // Nothing moves, but input is ignored until the pause is up.
+    return menu->ticks > PAUSE_TICKS ? GAMESTATE_IDLE_FOREVER : PAUSE_TICKS + 1 - menu->ticks;
 }
 
 static void
@@ -60,7 +67,7 @@ menu_main_event(gamestate_mgr_handle mgr,
         }
     // Deliberate fallthrough
     case SDL_MOUSEBUTTONUP:
-        if (menu->time > PAUSE_TIME) {
+        if (menu->ticks > PAUSE_TICKS) {
             gamestate_pop(mgr);
         }
 
@@ -71,9 +78,13 @@ menu_main_event(gamestate_mgr_handle mgr,
 static void
 menu_main_cleanup(menu_main_info_type *menu)
 {
-    mapped_font_destroy(menu->mini_font);
-    mapped_font_destroy(menu->small_font);
-    mapped_font_destroy(menu->big_font);
+    mapped_text_destroy(menu->credits_text);
+    mapped_text_destroy(menu->start_text);
+    mapped_text_destroy(menu->tutorial_text);
+    mapped_text_destroy(menu->title_text);
+    mapped_font_release(menu->mini_font);
+    mapped_font_release(menu->small_font);
+    mapped_font_release(menu->big_font);
     free(menu);
 }
 
@@ -82,19 +93,40 @@ menu_main_init(SDL_Renderer *renderer)
 {
     gamestate_type gamestate;
     menu_main_info_type *menu;
+    int y = SMALL_FONT_SIZE;
+    int center = main_screen_width() / 2;
+    PROFILE_BEGIN(init, "menu.init");
 
     menu = calloc(1, sizeof(*menu));
     menu->renderer = renderer;
-    menu->big_font = mapped_font_create(renderer, "media/fonts/hud.ttf", BIG_FONT_SIZE);
-    menu->small_font = mapped_font_create(renderer, "media/fonts/hud.ttf", SMALL_FONT_SIZE);
-    menu->mini_font = mapped_font_create(renderer, "media/fonts/hud.ttf", MINI_FONT_SIZE);
+    menu->big_font = mapped_font_acquire(renderer, "media/fonts/hud.ttf", BIG_FONT_SIZE);
+    menu->small_font = mapped_font_acquire(renderer, "media/fonts/hud.ttf", SMALL_FONT_SIZE);
+    menu->mini_font = mapped_font_acquire(renderer, "media/fonts/hud.ttf", MINI_FONT_SIZE);
+
+    // The menu text never changes, so it's laid out once here.
+    menu->title_text = mapped_text_create(menu->big_font, center, y, color_white, ALIGN_CENTER);
+    mapped_text_set(menu->title_text, "LD41");
+    y += BIG_FONT_SIZE + SMALL_FONT_SIZE * 2;
+
+    menu->tutorial_text = mapped_text_create(menu->small_font, center, y, color_white, ALIGN_CENTER);
+    mapped_text_set(menu->tutorial_text, "Press T for tutorial");
+    y += SMALL_FONT_SIZE;
+    menu->start_text = mapped_text_create(menu->small_font, center, y, color_white, ALIGN_CENTER);
+    mapped_text_set(menu->start_text, "Or any other key to start");
+
+    menu->credits_text = mapped_text_create(menu->mini_font, center, main_screen_height() - MINI_FONT_SIZE * 2,
+                                            color_white, ALIGN_CENTER);
+    mapped_text_set(menu->credits_text, "Game by Juzley, Assets from kenney.nl");
 
     gamestate.update_cb = (gamestate_update_fn_type)&menu_main_update;
     gamestate.draw_cb = (gamestate_draw_fn_type)&menu_main_draw;
     gamestate.event_cb = (gamestate_event_fn_type)&menu_main_event;
     gamestate.cleanup_cb = (gamestate_cleanup_fn_type)&menu_main_cleanup;
+    gamestate.idle_cb = (gamestate_idle_fn_type)&menu_main_idle;
     gamestate.flags = GAMESTATE_FLAG_DRAW_UNDER;
+    gamestate.name = "menu";
     gamestate.ctx = menu;
 
+    PROFILE_END(init);
     return gamestate;
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "move.h"
+#include "sim.h"
+
+
+/*
+ * See move.h for details.
+ */
+size_t
+move_generate(const sim_type *sim,
+              move_type      *moves)
+{
+    size_t count = 0;
+    size_t x;
+    size_t y;
+
+    for (x = 0; x < sim->width; x++) {
+        for (y = 0; y < sim->height; y++) {
+            if (x + 1 < sim->width) {
+                moves[count].a.x = x;
+                moves[count].a.y = y;
+                moves[count].b.x = x + 1;
+                moves[count].b.y = y;
+                count++;
+            }
+            if (y + 1 < sim->height) {
+                moves[count].a.x = x;
+                moves[count].a.y = y;
+                moves[count].b.x = x;
+                moves[count].b.y = y + 1;
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+
+/*
+ * See move.h for details.
+ */
+int64_t
+move_value(const sim_move_eval_type *eval)
+{
+    return (int64_t)eval->energy * 1000000 + eval->score;
+}
+
+
+/*
+ * See move.h for details.
+ */
+bool
+move_best(sim_type           *sim,
+          move_type          *best,
+          sim_move_eval_type *eval)
+{
+    move_type          move;
+    sim_move_eval_type move_eval;
+    sim_move_eval_type best_eval;
+    size_t             x;
+    size_t             y;
+    unsigned int       direction;
+    int64_t            value;
+    int64_t            best_value = INT64_MIN;
+
+    // Go through the moves in the same order as move_generate, without
+    // needing room for them all.
+    for (x = 0; x < sim->width; x++) {
+        for (y = 0; y < sim->height; y++) {
+            for (direction = 0; direction < 2; direction++) {
+                move.a.x = x;
+                move.a.y = y;
+                move.b.x = x + (direction == 0);
+                move.b.y = y + (direction == 1);
+                if (move.b.x >= sim->width || move.b.y >= sim->height) {
+                    continue;
+                }
+
+                sim_evaluate_move(sim, move.a, move.b, &move_eval);
+
+                value = move_value(&move_eval);
+                if (value > best_value) {
+                    best_value = value;
+                    best_eval = move_eval;
+                    *best = move;
+                }
+            }
+        }
+    }
+
+    if (eval != NULL) {
+        *eval = best_eval;
+    }
+
+    return best_eval.cleared > 0;
+}
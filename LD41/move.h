@@ -0,0 +1,48 @@
+#ifndef __MOVE_H__
+#define __MOVE_H__
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+
+typedef struct move {
+    coord_type a;
+    coord_type b;
+} move_type;
+
+
+/*
+ * The number of possible swaps: every pair of horizontally or vertically
+ * adjacent tiles.
+ */
+static inline size_t
+move_count(const sim_type *sim)
+{
+    return (sim->width - 1) * sim->height + sim->width * (sim->height - 1);
+}
+
+/*
+ * Fill in every possible swap, returning the number of moves. moves must have
+ * room for move_count moves.
+ */
+size_t move_generate(const sim_type *sim, move_type *moves);
+
+/*
+ * Rank a move's immediate outcome. Staying alive comes first, so energy
+ * outweighs any amount of score.
+ */
+int64_t move_value(const sim_move_eval_type *eval);
+
+/*
+ * Find the move with the best immediate outcome on a settled board. Returns
+ * false if no move clears anything, in which case best is still set to a
+ * legal move. eval may be NULL.
+ */
+bool move_best(sim_type *sim, move_type *best, sim_move_eval_type *eval);
+
+
+#endif /* __MOVE_H__ */
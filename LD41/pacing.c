@@ -0,0 +1,46 @@
+#include <stdint.h>
+#include "pacing.h"
+#include "platform.h"
+
+// How far short of a frame's start to stop sleeping and spin instead. About
+// as much as sleeps overshoot on the platforms without precise timers.
+#define PACING_SPIN_NS 500000
+
+
+/*
+ * See pacing.h for details.
+ */
+void
+pacing_init(pacing_type  *pacing,
+            unsigned int  fps)
+{
+    pacing->frame_ns = fps > 0 ? 1000000000ULL / fps : 0;
+    pacing->next_frame = platform_time_ns();
+}
+
+
+/*
+ * See pacing.h for details.
+ */
+void
+pacing_wait(pacing_type *pacing)
+{
+    uint64_t now;
+
+    if (pacing->frame_ns == 0) {
+        return;
+    }
+
+    now = platform_time_ns();
+    if (now < pacing->next_frame) {
+        if (pacing->next_frame - now > PACING_SPIN_NS) {
+            platform_sleep_ns(pacing->next_frame - now - PACING_SPIN_NS);
+        }
+        while (platform_time_ns() < pacing->next_frame) {
+        }
+    } else if (now - pacing->next_frame > pacing->frame_ns) {
+        pacing->next_frame = now;
+    }
+
+    pacing->next_frame += pacing->frame_ns;
+}
@@ -0,0 +1,35 @@
+#ifndef __PACING_H__
+#define __PACING_H__
+
+
+/*
+ * Frame pacing: holding frames to a target rate by sleeping until each is
+ * due, rather than drawing as fast as the machine allows. Sleeps stop a
+ * little short and spin the rest of the way, so frames land on time even
+ * where the OS oversleeps.
+ */
+
+#include <stdint.h>
+
+
+typedef struct pacing {
+    uint64_t frame_ns;   // 0 to run uncapped.
+    uint64_t next_frame; // platform_time_ns when the next frame is due.
+} pacing_type;
+
+
+/*
+ * Pace frames to fps, or not at all given 0, e.g. when the renderer already
+ * waits for vsync when presenting.
+ */
+void pacing_init(pacing_type *pacing, unsigned int fps);
+
+/*
+ * Wait until the next frame is due. Call once a frame, after presenting. A
+ * frame that runs over a whole frame late (or a wait for input) restarts
+ * pacing from now, rather than rushing the frames after it.
+ */
+void pacing_wait(pacing_type *pacing);
+
+
+#endif /* __PACING_H__ */
@@ -0,0 +1,299 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_mixer.h>
+#include "pack.h"
+#include "platform.h"
+
+#define ALIGN_UP(x) (((x) + PACK_ALIGN - 1) / PACK_ALIGN * PACK_ALIGN)
+
+// The game's media pack, if it has one.
+static pack_file_type pack_media = { 0 };
+
+
+/*
+ * Whether the entry's data lies inside the file and holds what its kind
+ * says it does.
+ */
+static bool
+pack_entry_ok(const pack_file_type  *file,
+              const pack_entry_type *entry)
+{
+    uint64_t needed;
+
+    if (memchr(entry->name, '\0', PACK_NAME_LENGTH) == NULL ||
+        entry->offset % PACK_ALIGN != 0 || entry->offset > file->size || entry->size > file->size - entry->offset) {
+        return false;
+    }
+
+    switch (entry->kind) {
+    case PACK_ENTRY_IMAGE:
+        needed = (uint64_t)entry->pitch * entry->height;
+        return entry->format == PACK_PIXEL_FORMAT &&
+               entry->pitch >= (uint64_t)entry->width * 4 && needed <= entry->size;
+
+    case PACK_ENTRY_SOUND:
+        return entry->size <= UINT32_MAX;
+
+    case PACK_ENTRY_FONT:
+        needed = (uint64_t)entry->count * sizeof(pack_glyph_type) + (uint64_t)entry->pitch * entry->height;
+        return entry->format == PACK_PIXEL_FORMAT &&
+               entry->pitch >= (uint64_t)entry->width * 4 && needed <= entry->size;
+    }
+
+    return false;
+}
+
+
+/*
+ * See pack.h for details.
+ */
+bool
+pack_file_open(pack_file_type *file,
+               const char     *filename)
+{
+    const pack_header_type *header;
+    uint32_t                i;
+    bool                    ok;
+
+    memset(file, 0, sizeof(*file));
+    file->map = platform_map_file(filename, &file->size);
+    if (file->map == NULL) {
+        return false;
+    }
+
+    header = (const pack_header_type *)file->map;
+    ok = file->size >= sizeof(*header) &&
+         memcmp(header->magic, PACK_MAGIC, sizeof(header->magic)) == 0 &&
+         header->version == PACK_VERSION &&
+         header->entry_count <= (file->size - sizeof(*header)) / sizeof(pack_entry_type);
+
+    if (ok) {
+        file->entries = (const pack_entry_type *)(header + 1);
+        file->entry_count = header->entry_count;
+        for (i = 0; ok && i < file->entry_count; i++) {
+            ok = pack_entry_ok(file, &file->entries[i]);
+        }
+    }
+
+    if (!ok) {
+        pack_file_close(file);
+    }
+
+    return ok;
+}
+
+
+/*
+ * See pack.h for details.
+ */
+void
+pack_file_close(pack_file_type *file)
+{
+    platform_unmap_file(file->map, file->size);
+    memset(file, 0, sizeof(*file));
+}
+
+
+/*
+ * See pack.h for details.
+ */
+const pack_entry_type *
+pack_file_find(const pack_file_type *file,
+               const char           *name,
+               pack_entry_kind_type  kind)
+{
+    uint32_t i;
+
+    for (i = 0; i < file->entry_count; i++) {
+        if (file->entries[i].kind == kind && strcmp(file->entries[i].name, name) == 0) {
+            return &file->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * See pack.h for details.
+ */
+const void *
+pack_file_data(const pack_file_type  *file,
+               const pack_entry_type *entry)
+{
+    return file->map + entry->offset;
+}
+
+
+/*
+ * See pack.h for details.
+ */
+bool
+pack_file_write(const char            *filename,
+                const pack_entry_type *entries,
+                const void *const     *data,
+                uint32_t               count)
+{
+    static const uint8_t padding[PACK_ALIGN] = { 0 };
+    pack_header_type     header = { 0 };
+    pack_entry_type      entry;
+    FILE                *file;
+    uint64_t             offset;
+    size_t               pad;
+    uint32_t             i;
+    bool                 ok;
+
+    file = fopen(filename, "wb");
+    if (file == NULL) {
+        return false;
+    }
+
+    memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+    header.version = PACK_VERSION;
+    header.entry_count = count;
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    offset = ALIGN_UP(sizeof(header) + (uint64_t)count * sizeof(entry));
+    for (i = 0; ok && i < count; i++) {
+        entry = entries[i];
+        entry.offset = offset;
+        ok = fwrite(&entry, sizeof(entry), 1, file) == 1;
+        offset = ALIGN_UP(offset + entry.size);
+    }
+
+    offset = sizeof(header) + (uint64_t)count * sizeof(entry);
+    for (i = 0; ok && i < count; i++) {
+        pad = (size_t)(ALIGN_UP(offset) - offset);
+        ok = fwrite(padding, 1, pad, file) == pad &&
+             fwrite(data[i], 1, (size_t)entries[i].size, file) == entries[i].size;
+        offset += pad + entries[i].size;
+    }
+
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+
+    if (!ok) {
+        (void)remove(filename);
+    }
+
+    return ok;
+}
+
+
+/*
+ * See pack.h for details.
+ */
+bool
+pack_open(const char *filename)
+{
+    pack_close();
+
+    if (!pack_file_open(&pack_media, filename)) {
+        SDL_Log("No usable asset pack at %s, loading loose files instead", filename);
+        return false;
+    }
+
+    return true;
+}
+
+
+/*
+ * See pack.h for details.
+ */
+void
+pack_close(void)
+{
+    pack_file_close(&pack_media);
+}
+
+
+/*
+ * See pack.h for details.
+ */
+const pack_entry_type *
+pack_find(const char           *name,
+          pack_entry_kind_type  kind)
+{
+    return pack_file_find(&pack_media, name, kind);
+}
+
+
+/*
+ * See pack.h for details.
+ */
+const void *
+pack_data(const pack_entry_type *entry)
+{
+    return pack_file_data(&pack_media, entry);
+}
+
+
+/*
+ * See pack.h for details.
+ */
+void
+pack_font_name(char       *name,
+               size_t      size,
+               const char *filename,
+               int         height)
+{
+    (void)snprintf(name, size, "%s@%d", filename, height);
+}
+
+
+/*
+ * See pack.h for details.
+ */
+SDL_Surface *
+pack_load_surface(const char *filename)
+{
+    const pack_entry_type *entry;
+
+    entry = pack_find(filename, PACK_ENTRY_IMAGE);
+    if (entry == NULL) {
+        return IMG_Load(filename);
+    }
+
+    // SDL only reads the pixels of a surface made this way, so the mapping
+    // being read only is fine.
+    return SDL_CreateRGBSurfaceWithFormatFrom((void *)pack_data(entry),
+                                              (int)entry->width,
+                                              (int)entry->height,
+                                              32,
+                                              (int)entry->pitch,
+                                              entry->format);
+}
+
+
+/*
+ * See pack.h for details.
+ */
+Mix_Chunk *
+pack_load_sound(const char *filename)
+{
+    const pack_entry_type *entry;
+    int                    frequency;
+    Uint16                 format;
+    int                    channels;
+
+    // The samples are played as they are, so they have to be in the format
+    // the mixer was opened with.
+    entry = pack_find(filename, PACK_ENTRY_SOUND);
+    if (entry == NULL ||
+        Mix_QuerySpec(&frequency, &format, &channels) == 0 ||
+        (uint32_t)frequency != entry->frequency ||
+        format != entry->format ||
+        (uint32_t)channels != entry->channels) {
+        return Mix_LoadWAV(filename);
+    }
+
+    // Quick loaded chunks don't own their samples, so freeing one leaves the
+    // pack alone.
+    return Mix_QuickLoad_RAW((Uint8 *)pack_data(entry), (Uint32)entry->size);
+}
@@ -0,0 +1,132 @@
+#ifndef __PACK_H__
+#define __PACK_H__
+
+
+/*
+ * Pre-baked asset packs. LD41Pack decodes the game's media offline into one
+ * file: images as raw pixels in the renderer's usual format, sounds as PCM in
+ * the mixer's format and fonts as rasterized glyph bitmaps. The game maps the
+ * pack and points surfaces and chunks straight into it, so nothing is decoded
+ * or copied at startup.
+ *
+ * Anything missing from the pack, or the whole pack if it is missing or
+ * doesn't match (e.g. an older version, or a pack written on a machine of the
+ * other byte order), is loaded from the loose files instead.
+ *
+ * The file is a pack_header_type, then entry_count pack_entry_type, then the
+ * data, each entry's starting on a PACK_ALIGN boundary. Everything is in the
+ * packer's byte order.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <SDL.h>
+#include <SDL_mixer.h>
+
+#define PACK_MAGIC "LD41PACK"
+#define PACK_VERSION 1
+#define PACK_NAME_LENGTH 64
+#define PACK_ALIGN 16
+
+// Images are stored in the format most renderers use natively, so creating a
+// texture from them is a straight copy.
+#define PACK_PIXEL_FORMAT SDL_PIXELFORMAT_ARGB8888
+
+typedef enum {
+    PACK_ENTRY_IMAGE,   // width x height pixels, pitch bytes a row.
+    PACK_ENTRY_SOUND,   // PCM in format, at frequency, with channels interleaved.
+    PACK_ENTRY_FONT,    // count glyph rects, then the bitmap straight after them.
+} pack_entry_kind_type;
+
+typedef struct pack_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+} pack_header_type;
+
+typedef struct pack_entry {
+    char     name[PACK_NAME_LENGTH]; // The file it came from, e.g. "media/sounds/swap.ogg". See pack_font_name.
+    uint32_t kind;
+    uint32_t format;                 // SDL pixel format for images and fonts, audio format for sounds.
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint32_t frequency;
+    uint32_t channels;
+    uint32_t count;
+    uint64_t offset;                 // From the start of the file.
+    uint64_t size;
+} pack_entry_type;
+
+// One glyph in a font entry.
+typedef struct pack_glyph {
+    int32_t x;
+    int32_t y;
+    int32_t w;
+    int32_t h;
+} pack_glyph_type;
+
+
+/*
+ * A mapped pack file. The game's media pack is one, opened with pack_open,
+ * but any file in the same format can be mapped alongside it, e.g. the font
+ * cache's (see font.c).
+ */
+typedef struct pack_file {
+    const uint8_t         *map;
+    size_t                 size;
+    const pack_entry_type *entries;
+    uint32_t               entry_count;
+} pack_file_type;
+
+
+/*
+ * Map and check a pack file. Returns false, leaving file closed, if it can't
+ * be opened or isn't a valid pack. Closing a closed file does nothing.
+ */
+bool pack_file_open(pack_file_type *file, const char *filename);
+void pack_file_close(pack_file_type *file);
+
+const pack_entry_type *pack_file_find(const pack_file_type *file, const char *name, pack_entry_kind_type kind);
+const void *pack_file_data(const pack_file_type *file, const pack_entry_type *entry);
+
+/*
+ * Write a pack of count entries, where data[i] holds entries[i].size bytes.
+ * Their offsets are ignored and worked out as they're written. Returns false,
+ * leaving no file behind, if writing fails.
+ */
+bool pack_file_write(const char            *filename,
+                     const pack_entry_type *entries,
+                     const void *const     *data,
+                     uint32_t               count);
+
+/*
+ * Map the pack to load from. Returns false, leaving everything to load from
+ * loose files, if it can't be opened or isn't a valid pack. Call before any
+ * loading starts, and close only once everything loaded from it is freed.
+ */
+bool pack_open(const char *filename);
+void pack_close(void);
+
+/*
+ * The entry with the given name and kind, or NULL if there's no pack open or
+ * it doesn't have one. Safe from any thread while the pack is open.
+ */
+const pack_entry_type *pack_find(const char *name, pack_entry_kind_type kind);
+const void *pack_data(const pack_entry_type *entry);
+
+/*
+ * The name fonts are stored under, e.g. "media/fonts/hud.ttf@32".
+ */
+void pack_font_name(char *name, size_t size, const char *filename, int height);
+
+/*
+ * Load an image or sound from the pack, pointing into it, or from the file if
+ * the pack doesn't have it. Free the results as usual. Safe from any thread.
+ */
+SDL_Surface *pack_load_surface(const char *filename);
+Mix_Chunk *pack_load_sound(const char *filename);
+
+
+#endif /* __PACK_H__ */
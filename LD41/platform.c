@@ -0,0 +1,384 @@
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "platform.h"
+
+typedef struct platform_thread {
+#if defined(_WIN32)
+    HANDLE                  handle;
+#else
+    pthread_t               handle;
+#endif
+    platform_thread_fn_type fn;
+    void                   *ctx;
+    int                     result;
+} platform_thread_type;
+
+typedef struct platform_mutex {
+#if defined(_WIN32)
+    SRWLOCK         lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} platform_mutex_type;
+
+typedef struct platform_cond {
+#if defined(_WIN32)
+    CONDITION_VARIABLE cond;
+#else
+    pthread_cond_t     cond;
+#endif
+} platform_cond_type;
+
+
+#if defined(_WIN32)
+static DWORD WINAPI
+platform_thread_main(LPVOID param)
+#else
+static void *
+platform_thread_main(void *param)
+#endif
+{
+    platform_thread_type *thread = param;
+
+    thread->result = thread->fn(thread->ctx);
+
+#if defined(_WIN32)
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+
+platform_thread_handle
+platform_thread_create(platform_thread_fn_type  fn,
+                       void                    *ctx)
+{
+    platform_thread_handle thread;
+    bool                   ok;
+
+    thread = calloc(1, sizeof(*thread));
+    if (thread == NULL) {
+        return NULL;
+    }
+
+    thread->fn = fn;
+    thread->ctx = ctx;
+#if defined(_WIN32)
+    thread->handle = CreateThread(NULL, 0, &platform_thread_main, thread, 0, NULL);
+    ok = thread->handle != NULL;
+#else
+    ok = pthread_create(&thread->handle, NULL, &platform_thread_main, thread) == 0;
+#endif
+
+    if (!ok) {
+        free(thread);
+        thread = NULL;
+    }
+
+    return thread;
+}
+
+
+/*
+ * See platform.h for details.
+ */
+int
+platform_thread_join(platform_thread_handle thread)
+{
+    int result;
+
+#if defined(_WIN32)
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+
+    result = thread->result;
+    free(thread);
+
+    return result;
+}
+
+
+platform_mutex_handle
+platform_mutex_create(void)
+{
+    platform_mutex_handle mutex;
+
+    mutex = calloc(1, sizeof(*mutex));
+    if (mutex != NULL) {
+#if defined(_WIN32)
+        InitializeSRWLock(&mutex->lock);
+#else
+        (void)pthread_mutex_init(&mutex->lock, NULL);
+#endif
+    }
+
+    return mutex;
+}
+
+
+void
+platform_mutex_destroy(platform_mutex_handle mutex)
+{
+#if !defined(_WIN32)
+    (void)pthread_mutex_destroy(&mutex->lock);
+#endif
+    free(mutex);
+}
+
+
+void
+platform_mutex_lock(platform_mutex_handle mutex)
+{
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(&mutex->lock);
+#else
+    (void)pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+
+void
+platform_mutex_unlock(platform_mutex_handle mutex)
+{
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(&mutex->lock);
+#else
+    (void)pthread_mutex_unlock(&mutex->lock);
+#endif
+}
+
+
+platform_cond_handle
+platform_cond_create(void)
+{
+    platform_cond_handle cond;
+
+    cond = calloc(1, sizeof(*cond));
+    if (cond != NULL) {
+#if defined(_WIN32)
+        InitializeConditionVariable(&cond->cond);
+#else
+        (void)pthread_cond_init(&cond->cond, NULL);
+#endif
+    }
+
+    return cond;
+}
+
+
+void
+platform_cond_destroy(platform_cond_handle cond)
+{
+#if !defined(_WIN32)
+    (void)pthread_cond_destroy(&cond->cond);
+#endif
+    free(cond);
+}
+
+
+void
+platform_cond_wait(platform_cond_handle  cond,
+                   platform_mutex_handle mutex)
+{
+#if defined(_WIN32)
+    SleepConditionVariableSRW(&cond->cond, &mutex->lock, INFINITE, 0);
+#else
+    (void)pthread_cond_wait(&cond->cond, &mutex->lock);
+#endif
+}
+
+
+void
+platform_cond_signal(platform_cond_handle cond)
+{
+#if defined(_WIN32)
+    WakeConditionVariable(&cond->cond);
+#else
+    (void)pthread_cond_signal(&cond->cond);
+#endif
+}
+
+
+void
+platform_cond_broadcast(platform_cond_handle cond)
+{
+#if defined(_WIN32)
+    WakeAllConditionVariable(&cond->cond);
+#else
+    (void)pthread_cond_broadcast(&cond->cond);
+#endif
+}
+
+
+unsigned int
+platform_cpu_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return count > 0 ? (unsigned int)count : 1;
+#endif
+}
+
+
+/*
+ * See platform.h for details.
+ */
+uint64_t
+platform_time_ns(void)
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER        counter;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+
+    // Split the conversion to avoid overflowing on long uptimes.
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+
+/*
+ * See platform.h for details.
+ */
+void
+platform_sleep_ns(uint64_t ns)
+{
+#if defined(_WIN32)
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+    HANDLE        timer;
+    LARGE_INTEGER due;
+
+    // High resolution timers need Windows 10 1803 or later. Older versions
+    // fall back to Sleep, at the system timer's resolution.
+    timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (timer != NULL) {
+        // Negative for a relative time, in 100ns units.
+        due.QuadPart = -(LONGLONG)(ns / 100);
+        if (SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) {
+            (void)WaitForSingleObject(timer, INFINITE);
+            CloseHandle(timer);
+            return;
+        }
+        CloseHandle(timer);
+    }
+
+    Sleep((DWORD)(ns / 1000000));
+#else
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+#endif
+}
+
+
+/*
+ * See platform.h for details.
+ */
+const void *
+platform_map_file(const char *filename,
+                  size_t     *size)
+{
+    const void    *data = NULL;
+#if defined(_WIN32)
+    HANDLE         file;
+    HANDLE         mapping;
+    LARGE_INTEGER  file_size;
+
+    file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 && (uint64_t)file_size.QuadPart <= SIZE_MAX) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            // The view keeps the mapping alive once the handle is closed.
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+            *size = (size_t)file_size.QuadPart;
+        }
+    }
+
+    CloseHandle(file);
+#else
+    int            fd;
+    struct stat    st;
+    void          *mapped;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && (uint64_t)st.st_size <= SIZE_MAX) {
+        mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            data = mapped;
+            *size = (size_t)st.st_size;
+        }
+    }
+
+    close(fd);
+#endif
+
+    return data;
+}
+
+
+/*
+ * See platform.h for details.
+ */
+void
+platform_unmap_file(const void *data,
+                    size_t      size)
+{
+    if (data == NULL) {
+        return;
+    }
+
+#if defined(_WIN32)
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void *)data, size);
+#endif
+}
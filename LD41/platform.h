@@ -0,0 +1,65 @@
+#ifndef __PLATFORM_H__
+#define __PLATFORM_H__
+
+
+/*
+ * Threads, timing and file mapping for code that has to run without SDL, e.g.
+ * the headless simulation tools.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct platform_thread *platform_thread_handle;
+
+typedef int(*platform_thread_fn_type)(void *ctx);
+
+typedef struct platform_mutex *platform_mutex_handle;
+
+typedef struct platform_cond *platform_cond_handle;
+
+
+platform_thread_handle platform_thread_create(platform_thread_fn_type fn, void *ctx);
+
+/*
+ * Wait for a thread to finish and free it, returning the thread function's
+ * result.
+ */
+int platform_thread_join(platform_thread_handle thread);
+
+platform_mutex_handle platform_mutex_create(void);
+void platform_mutex_destroy(platform_mutex_handle mutex);
+void platform_mutex_lock(platform_mutex_handle mutex);
+void platform_mutex_unlock(platform_mutex_handle mutex);
+
+platform_cond_handle platform_cond_create(void);
+void platform_cond_destroy(platform_cond_handle cond);
+void platform_cond_wait(platform_cond_handle cond, platform_mutex_handle mutex);
+void platform_cond_signal(platform_cond_handle cond);
+void platform_cond_broadcast(platform_cond_handle cond);
+
+unsigned int platform_cpu_count(void);
+
+/*
+ * Monotonic time in nanoseconds from an arbitrary starting point.
+ */
+uint64_t platform_time_ns(void);
+
+/*
+ * Sleep for about ns nanoseconds. Where the OS has high resolution timers
+ * that's precise to a fraction of a millisecond; elsewhere it may oversleep
+ * by up to a scheduler tick.
+ */
+void platform_sleep_ns(uint64_t ns);
+
+/*
+ * Map a whole file into memory, read only. Returns NULL if the file can't be
+ * opened or is empty. Unmap it, with the size it was mapped with, once
+ * nothing points into it any more.
+ */
+const void *platform_map_file(const char *filename, size_t *size);
+void platform_unmap_file(const void *data, size_t size);
+
+
+#endif /* __PLATFORM_H__ */
@@ -0,0 +1,522 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include "font.h"
+#include "platform.h"
+#include "profile.h"
+#include "utils.h"
+
+// Samples the ring holds between frames.
+#define PROFILE_RING_SIZE 4096
+
+// Trace events buffered before they're written out.
+#define PROFILE_TRACE_EVENTS 65536
+
+// Slot sequence numbers count passes round the ring: a slot is free for
+// position pos at PROFILE_FREE(pos) and holds its sample at one more. Kept
+// in step with positions wrapping at 2^32.
+#define PROFILE_FREE(pos) ((int)((unsigned int)(pos) / PROFILE_RING_SIZE * 2))
+
+// Durations are counted in buckets on a log scale, each power of two split
+// in PROFILE_SUB_BUCKETS, so percentiles come out within an eighth. Anything
+// over 2^(PROFILE_MAX_POWER + 1) ns, about two minutes, counts as that.
+#define PROFILE_SUB_BUCKET_BITS 3
+#define PROFILE_SUB_BUCKETS (1 << PROFILE_SUB_BUCKET_BITS)
+#define PROFILE_MAX_POWER 36
+#define PROFILE_BUCKETS ((PROFILE_MAX_POWER - PROFILE_SUB_BUCKET_BITS + 2) * PROFILE_SUB_BUCKETS)
+
+#define PROFILE_FONT "media/fonts/hud.ttf"
+#define PROFILE_FONT_HEIGHT 24
+#define PROFILE_OVERLAY_X 8
+#define PROFILE_OVERLAY_Y 8
+#define PROFILE_OVERLAY_PADDING 6
+#define PROFILE_NAME_WIDTH 220
+#define PROFILE_COLUMN_WIDTH 90
+
+typedef struct profile_stats {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint32_t buckets[PROFILE_BUCKETS];
+} profile_stats_type;
+
+typedef struct profile_summary {
+    uint64_t count;
+    double   min_ms;
+    double   avg_ms;
+    double   p99_ms;
+    double   max_ms;
+} profile_summary_type;
+
+typedef struct profile_zone_info {
+    char                 name[PROFILE_NAME_LENGTH];
+    profile_stats_type   run;    // The whole run, for the CSV.
+    profile_stats_type   window; // The frames since the overlay was last updated.
+    profile_summary_type shown;  // The last full window, for the overlay.
+} profile_zone_info_type;
+
+typedef struct profile_event {
+    profile_zone_type zone;
+    SDL_threadID      thread;
+    uint64_t          start_ns;
+    uint64_t          duration_ns;
+} profile_event_type;
+
+typedef struct profile_sample {
+    SDL_atomic_t       sequence;
+    profile_event_type event;
+} profile_sample_type;
+
+static profile_zone_info_type profile_zones[PROFILE_MAX_ZONES];
+static SDL_atomic_t           profile_zone_count = { 0 };
+static SDL_SpinLock           profile_zone_lock = 0;
+
+// Written by any thread, read by the main thread in profile_frame.
+static profile_sample_type    profile_ring[PROFILE_RING_SIZE];
+static SDL_atomic_t           profile_ring_write = { 0 };
+static unsigned int           profile_ring_read = 0;
+
+static unsigned int           profile_window_frames = 0;
+static bool                   profile_overlay_shown = false;
+static mapped_font_handle     profile_font = NULL;
+
+// The trace, if one is being written. Main thread only.
+static FILE                  *profile_trace_file = NULL;
+static profile_event_type    *profile_trace_events = NULL;
+static size_t                 profile_trace_count = 0;
+static uint64_t               profile_trace_origin = 0;
+static uint64_t               profile_trace_budget = 0;
+static bool                   profile_trace_ok = true;
+
+
+static size_t
+profile_bucket(uint64_t ns)
+{
+    int power = PROFILE_SUB_BUCKET_BITS;
+
+    if (ns < PROFILE_SUB_BUCKETS) {
+        return (size_t)ns;
+    }
+
+    ns = MIN(ns, (2ULL << PROFILE_MAX_POWER) - 1);
+    while ((ns >> (power + 1)) != 0) {
+        power++;
+    }
+
+    return (size_t)(power - PROFILE_SUB_BUCKET_BITS + 1) * PROFILE_SUB_BUCKETS +
+           (size_t)(ns >> (power - PROFILE_SUB_BUCKET_BITS)) - PROFILE_SUB_BUCKETS;
+}
+
+
+/*
+ * The longest duration counted in a bucket.
+ */
+static uint64_t
+profile_bucket_limit(size_t bucket)
+{
+    int shift;
+
+    if (bucket < PROFILE_SUB_BUCKETS) {
+        return bucket;
+    }
+
+    shift = (int)(bucket / PROFILE_SUB_BUCKETS) - 1;
+    return ((uint64_t)(PROFILE_SUB_BUCKETS + bucket % PROFILE_SUB_BUCKETS + 1) << shift) - 1;
+}
+
+
+static void
+profile_stats_add(profile_stats_type *stats,
+                  uint64_t            ns)
+{
+    if (stats->count == 0 || ns < stats->min_ns) {
+        stats->min_ns = ns;
+    }
+    stats->max_ns = MAX(stats->max_ns, ns);
+    stats->count++;
+    stats->total_ns += ns;
+    stats->buckets[profile_bucket(ns)]++;
+}
+
+
+static void
+profile_summarize(const profile_stats_type *stats,
+                  profile_summary_type     *summary)
+{
+    uint64_t target;
+    uint64_t seen = 0;
+    size_t   bucket;
+
+    memset(summary, 0, sizeof(*summary));
+    if (stats->count == 0) {
+        return;
+    }
+
+    // The first bucket at or past which 99% of samples are counted.
+    target = stats->count - stats->count / 100;
+    for (bucket = 0; bucket < PROFILE_BUCKETS - 1; bucket++) {
+        seen += stats->buckets[bucket];
+        if (seen >= target) {
+            break;
+        }
+    }
+
+    summary->count = stats->count;
+    summary->min_ms = (double)stats->min_ns / 1e6;
+    summary->avg_ms = (double)stats->total_ns / (double)stats->count / 1e6;
+    summary->p99_ms = (double)MIN(profile_bucket_limit(bucket), stats->max_ns) / 1e6;
+    summary->max_ms = (double)stats->max_ns / 1e6;
+}
+
+
+/*
+ * See profile.h for details.
+ */
+profile_zone_type
+profile_zone(const char *name)
+{
+    profile_zone_type zone;
+    int               count;
+
+    SDL_AtomicLock(&profile_zone_lock);
+
+    count = SDL_AtomicGet(&profile_zone_count);
+    for (zone = 0; zone < count; zone++) {
+        if (strcmp(profile_zones[zone].name, name) == 0) {
+            break;
+        }
+    }
+
+    if (zone == count) {
+        if (count == PROFILE_MAX_ZONES) {
+            zone = PROFILE_NO_ZONE;
+        } else {
+            (void)snprintf(profile_zones[zone].name, sizeof(profile_zones[zone].name), "%s", name);
+            SDL_AtomicSet(&profile_zone_count, count + 1);
+        }
+    }
+
+    SDL_AtomicUnlock(&profile_zone_lock);
+
+    return zone;
+}
+
+
+/*
+ * See profile.h for details.
+ */
+uint64_t
+profile_begin(profile_zone_type *zone,
+              const char        *name)
+{
+    if (*zone == PROFILE_NO_ZONE) {
+        *zone = profile_zone(name);
+    }
+
+    return platform_time_ns();
+}
+
+
+/*
+ * See profile.h for details.
+ */
+void
+profile_end(profile_zone_type zone,
+            uint64_t          start)
+{
+    uint64_t             duration = platform_time_ns() - start;
+    profile_sample_type *slot;
+    unsigned int         pos;
+
+    if (zone == PROFILE_NO_ZONE) {
+        return;
+    }
+
+    // Claim the next slot. If it hasn't been emptied since the last time
+    // round, the ring is full and the sample is dropped; if another thread
+    // claimed it first, try the one after.
+    for (;;) {
+        pos = (unsigned int)SDL_AtomicGet(&profile_ring_write);
+        slot = &profile_ring[pos % PROFILE_RING_SIZE];
+        if (SDL_AtomicGet(&slot->sequence) == PROFILE_FREE(pos)) {
+            if (SDL_AtomicCAS(&profile_ring_write, (int)pos, (int)(pos + 1))) {
+                break;
+            }
+        } else if ((unsigned int)SDL_AtomicGet(&profile_ring_write) == pos) {
+            return;
+        }
+    }
+
+    slot->event.zone = zone;
+    slot->event.thread = SDL_ThreadID();
+    slot->event.start_ns = start;
+    slot->event.duration_ns = duration;
+    SDL_AtomicSet(&slot->sequence, PROFILE_FREE(pos) + 1);
+}
+
+
+/*
+ * Write out the buffered trace events.
+ */
+static void
+profile_trace_flush(void)
+{
+    const profile_event_type *event;
+    size_t                    i;
+
+    for (i = 0; i < profile_trace_count; i++) {
+        event = &profile_trace_events[i];
+        // Timestamps are in microseconds, from when the trace was opened.
+        if (fprintf(profile_trace_file,
+                    ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+                    profile_zones[event->zone].name, (unsigned long)event->thread,
+                    (double)(event->start_ns - profile_trace_origin) / 1e3,
+                    (double)event->duration_ns / 1e3) < 0) {
+            profile_trace_ok = false;
+        }
+    }
+
+    if (fflush(profile_trace_file) != 0) {
+        profile_trace_ok = false;
+    }
+    profile_trace_count = 0;
+}
+
+
+static void
+profile_trace_add(const profile_event_type *event)
+{
+    // Zones started before the trace was opened are left out.
+    if (event->start_ns < profile_trace_origin) {
+        return;
+    }
+
+    if (profile_trace_count == PROFILE_TRACE_EVENTS) {
+        profile_trace_flush();
+    }
+    profile_trace_events[profile_trace_count++] = *event;
+}
+
+
+/*
+ * See profile.h for details.
+ */
+void
+profile_frame(uint64_t frame_ns)
+{
+    profile_sample_type *slot;
+    profile_event_type  *event;
+    int                  count;
+    int                  zone;
+
+    // Stop at the first slot still being written, and pick it up next frame.
+    for (;;) {
+        slot = &profile_ring[profile_ring_read % PROFILE_RING_SIZE];
+        if (SDL_AtomicGet(&slot->sequence) != PROFILE_FREE(profile_ring_read) + 1) {
+            break;
+        }
+
+        event = &slot->event;
+        profile_stats_add(&profile_zones[event->zone].run, event->duration_ns);
+        profile_stats_add(&profile_zones[event->zone].window, event->duration_ns);
+        if (profile_trace_file != NULL) {
+            profile_trace_add(event);
+        }
+        SDL_AtomicSet(&slot->sequence, PROFILE_FREE(profile_ring_read + PROFILE_RING_SIZE));
+        profile_ring_read++;
+    }
+
+    // Get a hitch on disk straight away, in case it's followed by a crash.
+    if (profile_trace_file != NULL && frame_ns > profile_trace_budget) {
+        profile_trace_flush();
+    }
+
+    if (++profile_window_frames < PROFILE_WINDOW_FRAMES) {
+        return;
+    }
+
+    count = SDL_AtomicGet(&profile_zone_count);
+    for (zone = 0; zone < count; zone++) {
+        profile_summarize(&profile_zones[zone].window, &profile_zones[zone].shown);
+        memset(&profile_zones[zone].window, 0, sizeof(profile_zones[zone].window));
+    }
+    profile_window_frames = 0;
+}
+
+
+/*
+ * See profile.h for details.
+ */
+void
+profile_toggle_overlay(void)
+{
+    profile_overlay_shown = !profile_overlay_shown;
+}
+
+
+/*
+ * See profile.h for details.
+ */
+void
+profile_draw(SDL_Renderer *renderer)
+{
+    static const char *const  headings[] = { "min", "avg", "p99", "max" };
+    const profile_summary_type *shown;
+    SDL_Rect                  rect;
+    int                       count;
+    int                       zone;
+    int                       column;
+    int                       x;
+    int                       y;
+
+    if (!profile_overlay_shown) {
+        return;
+    }
+
+    if (profile_font == NULL) {
+        profile_font = mapped_font_acquire(renderer, PROFILE_FONT, PROFILE_FONT_HEIGHT);
+    }
+
+    count = SDL_AtomicGet(&profile_zone_count);
+    rect.x = PROFILE_OVERLAY_X;
+    rect.y = PROFILE_OVERLAY_Y;
+    rect.w = PROFILE_NAME_WIDTH + PROFILE_COLUMN_WIDTH * 4 + PROFILE_OVERLAY_PADDING * 2;
+    rect.h = (count + 1) * PROFILE_FONT_HEIGHT + PROFILE_OVERLAY_PADDING * 2;
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
+    SDL_RenderFillRect(renderer, &rect);
+
+    x = rect.x + PROFILE_OVERLAY_PADDING;
+    y = rect.y + PROFILE_OVERLAY_PADDING;
+    mapped_font_queuef(profile_font, x, y, ALIGN_LEFT, "zone (ms)");
+    for (column = 0; column < 4; column++) {
+        mapped_font_queuef(profile_font, x + PROFILE_NAME_WIDTH + PROFILE_COLUMN_WIDTH * (column + 1), y,
+                           ALIGN_RIGHT, "%s", headings[column]);
+    }
+
+    for (zone = 0; zone < count; zone++) {
+        shown = &profile_zones[zone].shown;
+        y += PROFILE_FONT_HEIGHT;
+        mapped_font_queuef(profile_font, x, y, ALIGN_LEFT, "%s", profile_zones[zone].name);
+        mapped_font_queuef(profile_font, x + PROFILE_NAME_WIDTH + PROFILE_COLUMN_WIDTH, y, ALIGN_RIGHT, "%.2f", shown->min_ms);
+        mapped_font_queuef(profile_font, x + PROFILE_NAME_WIDTH + PROFILE_COLUMN_WIDTH * 2, y, ALIGN_RIGHT, "%.2f", shown->avg_ms);
+        mapped_font_queuef(profile_font, x + PROFILE_NAME_WIDTH + PROFILE_COLUMN_WIDTH * 3, y, ALIGN_RIGHT, "%.2f", shown->p99_ms);
+        mapped_font_queuef(profile_font, x + PROFILE_NAME_WIDTH + PROFILE_COLUMN_WIDTH * 4, y, ALIGN_RIGHT, "%.2f", shown->max_ms);
+    }
+
+    mapped_font_flush(renderer, profile_font);
+}
+
+
+/*
+ * See profile.h for details.
+ */
+bool
+profile_write_csv(const char *filename)
+{
+    profile_summary_type summary;
+    FILE                *file;
+    int                  count;
+    int                  zone;
+    bool                 ok;
+
+    file = fopen(filename, "w");
+    if (file == NULL) {
+        return false;
+    }
+
+    fprintf(file, "zone,count,min_ms,avg_ms,p99_ms,max_ms\n");
+    count = SDL_AtomicGet(&profile_zone_count);
+    for (zone = 0; zone < count; zone++) {
+        profile_summarize(&profile_zones[zone].run, &summary);
+        fprintf(file, "%s,%llu,%.3f,%.3f,%.3f,%.3f\n",
+                profile_zones[zone].name, (unsigned long long)summary.count,
+                summary.min_ms, summary.avg_ms, summary.p99_ms, summary.max_ms);
+    }
+
+    ok = !ferror(file);
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+
+    return ok;
+}
+
+
+/*
+ * See profile.h for details.
+ */
+bool
+profile_trace_open(const char *filename,
+                   uint64_t    budget_ns)
+{
+    (void)profile_trace_close();
+
+    profile_trace_events = malloc(PROFILE_TRACE_EVENTS * sizeof(*profile_trace_events));
+    if (profile_trace_events == NULL) {
+        return false;
+    }
+
+    profile_trace_file = fopen(filename, "w");
+    if (profile_trace_file == NULL) {
+        free(profile_trace_events);
+        profile_trace_events = NULL;
+        return false;
+    }
+
+    profile_trace_count = 0;
+    profile_trace_origin = platform_time_ns();
+    profile_trace_budget = budget_ns;
+
+    // Events are written with a comma before each, so the names of the
+    // process and the thread opening the trace, taken to be the main one,
+    // go first.
+    profile_trace_ok = fprintf(profile_trace_file,
+                               "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                               "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"LD41\"}},\n"
+                               "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"main\"}}",
+                               (unsigned long)SDL_ThreadID()) >= 0;
+
+    return true;
+}
+
+
+/*
+ * See profile.h for details.
+ */
+bool
+profile_trace_close(void)
+{
+    bool ok;
+
+    if (profile_trace_file == NULL) {
+        return true;
+    }
+
+    profile_trace_flush();
+    if (fprintf(profile_trace_file, "\n]}\n") < 0) {
+        profile_trace_ok = false;
+    }
+    ok = fclose(profile_trace_file) == 0 && profile_trace_ok;
+
+    free(profile_trace_events);
+    profile_trace_file = NULL;
+    profile_trace_events = NULL;
+    profile_trace_count = 0;
+
+    return ok;
+}
+
+
+/*
+ * See profile.h for details.
+ */
+void
+profile_shutdown(void)
+{
+    mapped_font_release(profile_font);
+    profile_font = NULL;
+}
@@ -0,0 +1,108 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+
+/*
+ * Frame profiling. Code is timed in named zones: each gamestate's event,
+ * update and draw callbacks, presenting, and anything wrapped in
+ * PROFILE_BEGIN and PROFILE_END. Samples go through a lock-free ring, so
+ * zones can be timed from any thread, and once a frame the main thread
+ * drains them into each zone's minimum, average, 99th percentile and
+ * maximum.
+ *
+ * The overlay shows the figures for the last PROFILE_WINDOW_FRAMES frames,
+ * and the CSV written on exit has them for the whole run. Timing a zone
+ * costs two clock reads and an atomic, so it stays on in release builds.
+ *
+ * A trace can be written as well, with every zone timed on its own on a
+ * timeline, for finding out what a particular hitch was.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL.h>
+
+
+#define PROFILE_MAX_ZONES 64
+#define PROFILE_NAME_LENGTH 32
+#define PROFILE_NO_ZONE (-1)
+
+// Frames each set of figures on the overlay covers.
+#define PROFILE_WINDOW_FRAMES 120
+
+typedef int profile_zone_type;
+
+
+/*
+ * The zone with the given name, registered the first time it's asked for.
+ * Returns PROFILE_NO_ZONE, which nothing is recorded for, once there are
+ * PROFILE_MAX_ZONES. Safe from any thread.
+ */
+profile_zone_type profile_zone(const char *name);
+
+/*
+ * Start timing, registering *zone under name if it hasn't been, and return
+ * the start time for profile_end. Safe from any thread.
+ */
+uint64_t profile_begin(profile_zone_type *zone, const char *name);
+
+/*
+ * Record the time since start under zone. Samples are dropped if the ring
+ * fills before the next profile_frame. Safe from any thread.
+ */
+void profile_end(profile_zone_type zone, uint64_t start);
+
+/*
+ * Time the code between them under the named zone, registered the first
+ * time it's reached. scope names the pair, so several can share a block.
+ * The variables they declare are their own; code that needs the start time
+ * should call profile_begin or profile_zone itself.
+ */
+#define PROFILE_BEGIN(scope, name)                                    \
+    static profile_zone_type scope##_zone = PROFILE_NO_ZONE;          \
+    uint64_t scope##_start = profile_begin(&scope##_zone, (name))
+
+#define PROFILE_END(scope) profile_end(scope##_zone, scope##_start)
+
+/*
+ * Gather the frame's samples into the figures, and the trace if one is
+ * being written. Call once a frame, on the main thread, with how long the
+ * frame took.
+ */
+void profile_frame(uint64_t frame_ns);
+
+void profile_toggle_overlay(void);
+
+/*
+ * Draw the overlay, if it's shown.
+ */
+void profile_draw(SDL_Renderer *renderer);
+
+/*
+ * Write every zone's figures for the whole run as CSV. Returns false if the
+ * file can't be written.
+ */
+bool profile_write_csv(const char *filename);
+
+/*
+ * Start a trace of every zone timed from now on, in Chrome's trace event
+ * format, for chrome://tracing or Perfetto. The events are kept in memory and
+ * only written out when a frame takes longer than budget_ns, when they fill
+ * the buffer, and when the trace is closed, so writing doesn't cause hitches
+ * of its own. Returns false if the file can't be opened.
+ */
+bool profile_trace_open(const char *filename, uint64_t budget_ns);
+
+/*
+ * Write out the rest of the trace and close it. Returns false if any of it
+ * couldn't be written.
+ */
+bool profile_trace_close(void);
+
+/*
+ * Release the overlay's font.
+ */
+void profile_shutdown(void);
+
+
+#endif /* __PROFILE_H__ */
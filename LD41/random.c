@@ -0,0 +1,98 @@
+#include <stddef.h>
+#include <stdint.h>
+#include "random.h"
+
+
+static inline uint64_t
+random_rotate(uint64_t value,
+              unsigned int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+
+/*
+ * Scale a 32-bit random number into [0, range) by multiplying and keeping the
+ * top half. Some results would come up once more often than others, so the
+ * few draws that would cause that are thrown away and drawn again. That needs
+ * a division, but only when the low half is small enough that a redraw is
+ * possible, which for the small ranges used here is almost never.
+ */
+static inline uint32_t
+random_bounded(random_state_type *random,
+               uint32_t           value,
+               uint32_t           range)
+{
+    uint64_t product = (uint64_t)value * range;
+    uint32_t threshold;
+
+    if ((uint32_t)product < range) {
+        threshold = (0 - range) % range;
+        while ((uint32_t)product < threshold) {
+            product = (random_next(random) >> 32) * range;
+        }
+    }
+
+    return (uint32_t)(product >> 32);
+}
+
+
+/*
+ * See random.h for details.
+ */
+void
+random_seed(random_state_type *random,
+            uint64_t           seed)
+{
+    uint64_t z;
+    size_t   i;
+
+    // Expand the seed with SplitMix64, which never gives the all-zero state
+    // xoshiro can't leave.
+    for (i = 0; i < sizeof(random->state) / sizeof(*random->state); i++) {
+        z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        random->state[i] = z ^ (z >> 31);
+    }
+}
+
+
+/*
+ * See random.h for details.
+ */
+uint64_t
+random_next(random_state_type *random)
+{
+    uint64_t *s = random->state;
+    uint64_t result = random_rotate(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = random_rotate(s[3], 45);
+
+    return result;
+}
+
+
+/*
+ * See random.h for details.
+ */
+unsigned int
+random_range(random_state_type *random,
+             unsigned int       min,
+             unsigned int       max)
+{
+    const uint32_t range = 1 + max - min;
+
+    if (range == 0) {
+        // The whole 32-bit range.
+        return (unsigned int)(random_next(random) >> 32);
+    }
+
+    return min + random_bounded(random, (uint32_t)(random_next(random) >> 32), range);
+}
@@ -0,0 +1,34 @@
+#ifndef __RANDOM_H__
+#define __RANDOM_H__
+
+
+#include <stdint.h>
+
+
+/*
+ * A random number stream that can be seeded and carried around, so that
+ * independent streams (e.g. one per simulated game) are reproducible and
+ * don't share state. This is xoshiro256**, which is fast, passes the usual
+ * statistical tests and has far too long a period to ever repeat in a game.
+ */
+typedef struct random_state {
+    uint64_t state[4];
+} random_state_type;
+
+
+/*
+ * Start a stream from a seed. Any seed is fine, including 0, and nearby seeds
+ * give unrelated streams.
+ */
+void random_seed(random_state_type *random, uint64_t seed);
+
+uint64_t random_next(random_state_type *random);
+
+/*
+ * Find a random number in the closed interval [min, max], with every number
+ * equally likely. Assumes min <= max.
+ */
+unsigned int random_range(random_state_type *random, unsigned int min, unsigned int max);
+
+
+#endif /* __RANDOM_H__ */
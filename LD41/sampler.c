@@ -0,0 +1,118 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sampler.h"
+
+
+/*
+ * See sampler.h for details.
+ */
+bool
+sampler_build(sampler_type   *sampler,
+              const uint32_t *weights,
+              unsigned int    count)
+{
+    uint64_t     scaled[SAMPLER_MAX_OUTCOMES];
+    uint8_t      small[SAMPLER_MAX_OUTCOMES];
+    uint8_t      large[SAMPLER_MAX_OUTCOMES];
+    unsigned int small_count = 0;
+    unsigned int large_count = 0;
+    unsigned int i;
+    uint64_t     total = 0;
+    uint8_t      s;
+    uint8_t      l;
+
+    if (count == 0 || count > SAMPLER_MAX_OUTCOMES) {
+        return false;
+    }
+
+    for (i = 0; i < count; i++) {
+        total += weights[i];
+    }
+    if (total == 0 || total > UINT32_MAX) {
+        return false;
+    }
+
+    // Scale the weights so that a full column holds exactly total, then
+    // split them into columns that are under and over full.
+    for (i = 0; i < count; i++) {
+        scaled[i] = (uint64_t)weights[i] * count;
+        if (scaled[i] < total) {
+            small[small_count++] = (uint8_t)i;
+        } else {
+            large[large_count++] = (uint8_t)i;
+        }
+    }
+
+    // Top up each under-full column from an over-full one, which may then
+    // become under-full itself. All of this is exact integer arithmetic, so
+    // the columns always come out even.
+    while (small_count > 0 && large_count > 0) {
+        s = small[--small_count];
+        l = large[large_count - 1];
+
+        sampler->thresholds[s] = (uint32_t)((scaled[s] << 32) / total);
+        sampler->aliases[s] = l;
+
+        scaled[l] -= total - scaled[s];
+        if (scaled[l] < total) {
+            large_count--;
+            small[small_count++] = l;
+        }
+    }
+
+    // Whatever is left is exactly full, so always keeps its own outcome.
+    while (large_count > 0) {
+        l = large[--large_count];
+        sampler->thresholds[l] = UINT32_MAX;
+        sampler->aliases[l] = l;
+    }
+    while (small_count > 0) {
+        s = small[--small_count];
+        sampler->thresholds[s] = UINT32_MAX;
+        sampler->aliases[s] = s;
+    }
+
+    sampler->count = count;
+
+    return true;
+}
+
+
+/*
+ * One outcome from 32 random bits. Scaling by the count puts the column in
+ * the top half and leaves the position within it, to compare against the
+ * threshold, in the bottom.
+ */
+static inline uint8_t
+sampler_pick(const sampler_type *sampler,
+             uint32_t            bits)
+{
+    uint64_t     scaled = (uint64_t)bits * sampler->count;
+    unsigned int column = (unsigned int)(scaled >> 32);
+
+    return (uint8_t)((uint32_t)scaled < sampler->thresholds[column] ? column : sampler->aliases[column]);
+}
+
+
+/*
+ * See sampler.h for details.
+ */
+void
+sampler_fill(const sampler_type *sampler,
+             random_state_type  *random,
+             uint8_t            *out,
+             size_t              count)
+{
+    uint64_t bits;
+    size_t   i;
+
+    for (i = 0; i + 1 < count; i += 2) {
+        bits = random_next(random);
+        out[i] = sampler_pick(sampler, (uint32_t)(bits >> 32));
+        out[i + 1] = sampler_pick(sampler, (uint32_t)bits);
+    }
+    if (i < count) {
+        out[i] = sampler_pick(sampler, (uint32_t)(random_next(random) >> 32));
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+
+/*
+ * Weighted random choice between a small number of outcomes, using an alias
+ * table: each outcome gets an equal-width column, holding a threshold and a
+ * second "alias" outcome that fills whatever is left of the column. A draw
+ * picks a column and compares against its threshold, so it costs one random
+ * number and one lookup however many outcomes there are and however finely
+ * their weights are set.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "random.h"
+
+
+#define SAMPLER_MAX_OUTCOMES 16
+
+typedef struct sampler {
+    uint32_t     thresholds[SAMPLER_MAX_OUTCOMES]; // Chance, out of 2^32, of keeping the column's own outcome.
+    uint8_t      aliases[SAMPLER_MAX_OUTCOMES];
+    unsigned int count;
+} sampler_type;
+
+
+/*
+ * Build a sampler choosing outcome i with probability weights[i] / sum of
+ * weights. Returns false, leaving the sampler unchanged, if there are too
+ * many outcomes, the weights are all 0 or their sum doesn't fit in 32 bits.
+ */
+bool sampler_build(sampler_type *sampler, const uint32_t *weights, unsigned int count);
+
+static inline unsigned int
+sampler_draw(const sampler_type *sampler,
+             random_state_type  *random)
+{
+    uint64_t     bits = random_next(random);
+    unsigned int column = (unsigned int)(((bits >> 32) * sampler->count) >> 32);
+
+    return (uint32_t)bits < sampler->thresholds[column] ? column : sampler->aliases[column];
+}
+
+/*
+ * Fill out with count outcomes. This is cheaper than calling sampler_draw
+ * count times, as each number drawn from the stream is split between two
+ * outcomes.
+ */
+void sampler_fill(const sampler_type *sampler, random_state_type *random, uint8_t *out, size_t count);
+
+
+#endif /* __SAMPLER_H__ */
@@ -0,0 +1,209 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <SDL.h>
+#include "shelf.h"
+#include "utils.h"
+
+
+static int
+shelf_pow2(int value)
+{
+    int result = 1;
+
+    while (result < value) {
+        result *= 2;
+    }
+
+    return result;
+}
+
+
+/*
+ * Whether rect a goes in before rect b: tallest first, then widest, then in
+ * their original order, so packing comes out the same on every platform.
+ */
+static bool
+shelf_before(const SDL_Rect *rects,
+             size_t          a,
+             size_t          b)
+{
+    if (rects[a].h != rects[b].h) {
+        return rects[a].h > rects[b].h;
+    }
+    if (rects[a].w != rects[b].w) {
+        return rects[a].w > rects[b].w;
+    }
+    return a < b;
+}
+
+
+/*
+ * Place the rects, in order, on shelves across the given width, returning
+ * the height used.
+ */
+static int
+shelf_place(SDL_Rect     *rects,
+            const size_t *order,
+            size_t        count,
+            int           padding,
+            int           width)
+{
+    SDL_Rect *rect;
+    int       shelf_x = 0;
+    int       shelf_y = 0;
+    int       shelf_height = 0;
+    size_t    i;
+
+    for (i = 0; i < count; i++) {
+        rect = &rects[order[i]];
+        if (rect->w <= 0 || rect->h <= 0) {
+            rect->x = 0;
+            rect->y = 0;
+            continue;
+        }
+
+        if (shelf_x + rect->w + padding * 2 > width) {
+            shelf_x = 0;
+            shelf_y += shelf_height;
+            shelf_height = 0;
+        }
+
+        rect->x = shelf_x + padding;
+        rect->y = shelf_y + padding;
+
+        shelf_x += rect->w + padding * 2;
+        shelf_height = MAX(shelf_height, rect->h + padding * 2);
+    }
+
+    return shelf_y + shelf_height;
+}
+
+
+/*
+ * See shelf.h for details.
+ */
+bool
+shelf_pack(SDL_Rect *rects,
+           size_t    count,
+           int       padding,
+           int      *width,
+           int      *height)
+{
+    size_t *order;
+    size_t  i;
+    size_t  j;
+    size_t  tmp;
+    int     widest = 1;
+    int     try_width;
+    int     try_height;
+    int     best_width = 0;
+    int     best_height = 0;
+
+    order = malloc((count > 0 ? count : 1) * sizeof(*order));
+    if (order == NULL) {
+        return false;
+    }
+
+    for (i = 0; i < count; i++) {
+        order[i] = i;
+        if (rects[i].w > 0 && rects[i].h > 0) {
+            widest = MAX(widest, rects[i].w + padding * 2);
+        }
+    }
+
+    // Insertion sort, as there are only ever a few hundred rects, and qsort
+    // can't sort indices by what they point at.
+    for (i = 1; i < count; i++) {
+        tmp = order[i];
+        for (j = i; j > 0 && shelf_before(rects, tmp, order[j - 1]); j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = tmp;
+    }
+
+    // Try each width from the narrowest that fits the widest rect up to
+    // square, keeping whichever wastes least, then the squarest of those.
+    for (try_width = shelf_pow2(widest); ; try_width *= 2) {
+        try_height = shelf_pow2(MAX(shelf_place(rects, order, count, padding, try_width), 1));
+        if (best_width == 0 ||
+            (double)try_width * try_height < (double)best_width * best_height ||
+            ((double)try_width * try_height == (double)best_width * best_height &&
+             MAX(try_width, try_height) < MAX(best_width, best_height))) {
+            best_width = try_width;
+            best_height = try_height;
+        }
+
+        if (try_height <= try_width) {
+            break;
+        }
+    }
+
+    (void)shelf_place(rects, order, count, padding, best_width);
+    *width = best_width;
+    *height = best_height;
+
+    free(order);
+
+    return true;
+}
+
+
+/*
+ * See shelf.h for details.
+ */
+void
+shelf_init(shelf_type *shelf,
+           int         width,
+           int         height)
+{
+    shelf->width = width;
+    shelf->height = height;
+    shelf->x = 0;
+    shelf->y = 0;
+    shelf->shelf_height = 0;
+}
+
+
+/*
+ * See shelf.h for details.
+ */
+bool
+shelf_alloc(shelf_type *shelf,
+            int         w,
+            int         h,
+            int         padding,
+            SDL_Rect   *rect)
+{
+    int padded_w = w + padding * 2;
+    int padded_h = h + padding * 2;
+    int x = shelf->x;
+    int y = shelf->y;
+    int shelf_height = shelf->shelf_height;
+
+    if (padded_w > shelf->width) {
+        return false;
+    }
+
+    // Start a new shelf if this one is full across. The current shelf is
+    // always the bottom one, so it can grow to fit taller rects.
+    if (x + padded_w > shelf->width) {
+        x = 0;
+        y += shelf_height;
+        shelf_height = 0;
+    }
+
+    if (y + MAX(shelf_height, padded_h) > shelf->height) {
+        return false;
+    }
+
+    rect->x = x + padding;
+    rect->y = y + padding;
+    rect->w = w;
+    rect->h = h;
+
+    shelf->x = x + padded_w;
+    shelf->y = y;
+    shelf->shelf_height = MAX(shelf_height, padded_h);
+
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef __SHELF_H__
+#define __SHELF_H__
+
+
+/*
+ * Packing rectangles into a texture on shelves: rows as tall as their
+ * tallest rectangle, filled left to right. Rectangles go in tallest first,
+ * so each shelf wastes little height, and the texture is the smallest
+ * power-of-two size that holds them all, as near square as that allows.
+ * That keeps big fonts and large sprite sets inside renderers' texture
+ * limits.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL.h>
+
+
+/*
+ * Set the x and y of each rect from its w and h, leaving padding pixels
+ * clear all round it, and work out the texture size. Empty rects are put at
+ * 0, 0 and take no space. Returns false if memory runs out.
+ */
+bool shelf_pack(SDL_Rect *rects,
+                size_t    count,
+                int       padding,
+                int      *width,
+                int      *height);
+
+
+/*
+ * A texture of fixed size filled a rect at a time, for rects that turn up
+ * one by one (e.g. glyphs rasterized as they're first drawn). Nothing is
+ * ever freed, short of starting again with shelf_init.
+ */
+typedef struct shelf {
+    int width;
+    int height;
+    int x;            // Where the next rect goes on the current shelf.
+    int y;
+    int shelf_height; // Of the current shelf, padding included.
+} shelf_type;
+
+void shelf_init(shelf_type *shelf, int width, int height);
+
+/*
+ * Find room for a w by h rect, leaving padding pixels clear all round it.
+ * Returns false, leaving rect alone, if it doesn't fit.
+ */
+bool shelf_alloc(shelf_type *shelf,
+                 int         w,
+                 int         h,
+                 int         padding,
+                 SDL_Rect   *rect);
+
+
+#endif /* __SHELF_H__ */
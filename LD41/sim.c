@@ -0,0 +1,841 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitboard.h"
+#include "random.h"
+#include "sampler.h"
+#include "sim.h"
+
+// New tiles drawn at once while a column drops.
+#define SIM_DRAW_CHUNK 16
+
+
+// Everything a board check finds to clear, before it is applied. On large
+// boards the cells to clear are kept in the sim's erase map and cleared list
+// instead of erase_tiles.
+typedef struct sim_clear {
+    bitboard_type erase_tiles;
+    unsigned int  match_score;
+    unsigned int  enemies_killed;
+    unsigned int  ships_killed;
+} sim_clear_type;
+
+
+/*
+ * See sim.h for details.
+ */
+const uint32_t sim_default_tile_weights[TILE_COUNT] = {
+    [TILE_SHIP] = 4,
+    [TILE_LASER] = 6,
+    [TILE_ENEMY_LASER] = 3,
+    [TILE_ENEMY] = 4,
+    [TILE_ASTEROID_1] = 12,
+    [TILE_ASTEROID_2] = 12,
+    [TILE_ASTEROID_3] = 12,
+    [TILE_BOMB] = 1,
+};
+
+
+static inline void
+sim_raise_event(sim_type       *sim,
+                sim_event_type  event)
+{
+    if (sim->event_cb != NULL) {
+        sim->event_cb(event, sim->event_ctx);
+    }
+}
+
+static inline void
+sim_lines_add(sim_lines_type *lines,
+              size_t          line)
+{
+    if (!lines->flags[line]) {
+        lines->flags[line] = 1;
+        lines->list[lines->count++] = (uint32_t)line;
+    }
+}
+
+static inline void
+sim_lines_clear(sim_lines_type *lines)
+{
+    size_t i;
+
+    for (i = 0; i < lines->count; i++) {
+        lines->flags[lines->list[i]] = 0;
+    }
+    lines->count = 0;
+}
+
+static inline void
+sim_set_tile(sim_type  *sim,
+             size_t     x,
+             size_t     y,
+             tile_type  tile)
+{
+    size_t index = sim_index(sim, x, y);
+    tile_type old_tile;
+
+    if (sim->bitboard) {
+        old_tile = (tile_type)sim->tiles[index];
+        if (old_tile != TILE_EMPTY) {
+            sim->tile_masks[old_tile] &= ~BITBOARD_CELL(x, y);
+        }
+        if (tile != TILE_EMPTY) {
+            sim->tile_masks[tile] |= BITBOARD_CELL(x, y);
+        }
+        sim->dirty |= BITBOARD_CELL(x, y);
+    } else {
+        sim_lines_add(&sim->dirty_rows, y);
+        sim_lines_add(&sim->dirty_columns, x);
+    }
+    sim->tiles[index] = (uint8_t)tile;
+    sim->changes++;
+}
+
+static inline tile_type
+sim_random_tile(sim_type *sim)
+{
+    return (tile_type)sampler_draw(&sim->tile_sampler, &sim->random);
+}
+
+static void
+sim_fill_next_row(sim_type *sim)
+{
+    sampler_fill(&sim->tile_sampler, &sim->random, sim->next_row, sim->width);
+}
+
+/*
+ * Carve the per-cell state out of one block of memory, returning the size of
+ * the block. If memory is NULL, only the size is worked out.
+ */
+static size_t
+sim_layout(sim_type *sim,
+           uint8_t  *memory)
+{
+    size_t cells = sim->width * sim->height;
+    size_t large_cells = sim->bitboard ? 0 : cells;
+    size_t large_width = sim->bitboard ? 0 : sim->width;
+    size_t large_height = sim->bitboard ? 0 : sim->height;
+    size_t offset = 0;
+
+#define SIM_CARVE(field, count) \
+    do { \
+        sim->field = memory != NULL && (count) > 0 ? (void *)(memory + offset) : NULL; \
+        offset += (count) * sizeof(*sim->field); \
+    } while (0)
+
+    // The 32-bit arrays go first, so everything stays aligned.
+    SIM_CARVE(gap_bottoms, sim->width);
+    SIM_CARVE(gap_columns.list, sim->width);
+    SIM_CARVE(dirty_rows.list, large_height);
+    SIM_CARVE(dirty_columns.list, large_width);
+    SIM_CARVE(cleared, large_cells);
+    SIM_CARVE(tiles, cells);
+    SIM_CARVE(next_row, sim->width);
+    SIM_CARVE(gap_columns.flags, sim->width);
+    SIM_CARVE(dirty_rows.flags, large_height);
+    SIM_CARVE(dirty_columns.flags, large_width);
+    SIM_CARVE(erase, large_cells);
+
+#undef SIM_CARVE
+
+    return offset;
+}
+
+static inline void
+sim_mark_cell(sim_type       *sim,
+              sim_clear_type *clear,
+              size_t          x,
+              size_t          y)
+{
+    size_t index;
+
+    if (sim->bitboard) {
+        clear->erase_tiles |= BITBOARD_CELL(x, y);
+    } else {
+        index = sim_index(sim, x, y);
+        if (!sim->erase[index]) {
+            sim->erase[index] = 1;
+            sim->cleared[sim->cleared_count++] = (uint32_t)index;
+        }
+    }
+}
+
+static void
+sim_mark_erased(sim_type       *sim,
+                sim_clear_type *clear,
+                size_t          start_x,
+                size_t          start_y,
+                size_t          x_inc,
+                size_t          y_inc,
+                size_t          distance) {
+    // Shots that end on the bottom row reach one cell past it, which is
+    // ignored.
+    for (size_t i = 0; i <= distance && start_x + i * x_inc < sim->width && start_y + i * y_inc < sim->height; i++) {
+        sim_mark_cell(sim, clear, start_x + i * x_inc, start_y + i * y_inc);
+    }
+}
+
+static void
+sim_mark_erased_square(
+    sim_type *sim,
+    sim_clear_type *clear,
+    size_t mid_x,
+    size_t mid_y,
+    unsigned int *enemies_erased,
+    unsigned int *ships_erased)
+{
+    for (size_t x = (mid_x > 0 ? mid_x - 1 : 0); x < sim->width && x <= mid_x + 1; x++) {
+        for (size_t y = (mid_y > 0 ? mid_y - 1 : 0); y < sim->height && y <= mid_y + 1; y++) {
+            sim_mark_cell(sim, clear, x, y);
+
+            if (enemies_erased != NULL && sim_tile(sim, x, y) == TILE_ENEMY) {
+                *enemies_erased += 1;
+            }
+            if (ships_erased != NULL && sim_tile(sim, x, y) == TILE_SHIP) {
+                *ships_erased += 1;
+            }
+        }
+    }
+
+}
+
+static void
+sim_check_shot(sim_type *sim,
+               sim_clear_type *clear,
+               size_t start_x,
+               size_t start_y)
+{
+    size_t y;
+    tile_type org_tile = sim_tile(sim, start_x, start_y);
+    tile_type prev_tile = org_tile;
+    tile_type cur_tile;
+
+
+    if (org_tile != TILE_ENEMY && org_tile != TILE_BOMB) {
+        // This isn't a shootable thing.
+        return;
+    }
+
+    if (start_y + 2 >= sim->height) {
+        // Not enough space on the board for shooting.
+        return;
+    }
+
+    for (y = start_y + 1; y < sim->height; y++) {
+        cur_tile = sim_tile(sim, start_x, y);
+        if (org_tile == TILE_ENEMY && cur_tile == TILE_SHIP && prev_tile == TILE_LASER) {
+            // Player shoots enemy.
+            sim_mark_erased(sim, clear, start_x, start_y, 0, 1, y - start_y - 1);
+            clear->enemies_killed += 1;
+        } else if (org_tile == TILE_ENEMY && cur_tile == TILE_SHIP && prev_tile == TILE_ENEMY_LASER) {
+            // Enemy shoots player.
+            sim_mark_erased(sim, clear, start_x, start_y + 1, 0, 1, y - start_y);
+            clear->ships_killed += 1;
+        } else if (org_tile == TILE_ENEMY && cur_tile == TILE_BOMB && prev_tile == TILE_ENEMY_LASER) {
+            // Enemy shoots bomb.
+            sim_mark_erased(sim, clear, start_x, start_y + 1, 0, 1, y - start_y);
+            // We don't count an enemy killing an enemy to the score.
+            sim_mark_erased_square(sim, clear, start_x, y, NULL, &clear->ships_killed);
+        } else if (org_tile == TILE_BOMB && cur_tile == TILE_SHIP && prev_tile == TILE_LASER) {
+            // Player shoots bomb.
+            sim_mark_erased(sim, clear, start_x, start_y, 0, 1, y - start_y);
+            sim_mark_erased_square(sim, clear, start_x, start_y, &clear->enemies_killed, &clear->ships_killed);
+        } else if ((cur_tile != TILE_LASER || prev_tile == TILE_ENEMY_LASER) &&
+            (cur_tile != TILE_ENEMY_LASER || prev_tile == TILE_LASER)) {
+            // If this isn't valid run of laser fire, stop searching.
+            break;
+        }
+
+        prev_tile = cur_tile;
+    }
+}
+
+
+/*
+ * See sim.h for details.
+ */
+void
+sim_lose_energy(sim_type *sim,
+                uint8_t   damage)
+{
+    if (sim->energy > damage) {
+        sim->energy -= damage;
+    } else {
+        sim->energy = 0;
+    }
+}
+
+
+static void
+sim_find_shots(sim_type       *sim,
+               size_t          x,
+               sim_clear_type *clear)
+{
+    size_t y;
+
+    for (y = 0; y < sim->height; y++) {
+        sim_check_shot(sim, clear, x, y);
+    }
+}
+
+static inline void
+sim_find_matches(bitboard_type   mask,
+                 sim_clear_type *clear)
+{
+    unsigned int run_score;
+
+    clear->erase_tiles |= bitboard_runs(mask, &run_score);
+    clear->match_score += run_score;
+}
+
+/*
+ * Find the runs of 3 or more along one row or column of a large board,
+ * scoring them the same way as bitboard_runs.
+ */
+static void
+sim_find_line_matches(sim_type       *sim,
+                      sim_clear_type *clear,
+                      size_t          start_x,
+                      size_t          start_y,
+                      size_t          x_inc,
+                      size_t          y_inc,
+                      size_t          length)
+{
+    size_t    run_start = 0;
+    size_t    run;
+    size_t    i;
+    tile_type run_tile = sim_tile(sim, start_x, start_y);
+    tile_type tile;
+
+    for (i = 1; i <= length; i++) {
+        tile = i < length ? sim_tile(sim, start_x + i * x_inc, start_y + i * y_inc) : TILE_EMPTY;
+        if (tile == run_tile && tile != TILE_EMPTY) {
+            continue;
+        }
+
+        run = i - run_start;
+        if (run >= 3 && run_tile != TILE_EMPTY) {
+            // Every cell with at least 2 more after it starts a run, worth
+            // the number of cells left in the run minus one.
+            clear->match_score += (unsigned int)(run * (run - 1) / 2 - 1);
+            sim_mark_erased(sim, clear, start_x + run_start * x_inc, start_y + run_start * y_inc, x_inc, y_inc, run - 1);
+        }
+
+        run_start = i;
+        run_tile = tile;
+    }
+}
+
+static inline void
+sim_find_row_matches(sim_type       *sim,
+                     sim_clear_type *clear,
+                     size_t          y)
+{
+    sim_find_line_matches(sim, clear, 0, y, 1, 0, sim->width);
+}
+
+static inline void
+sim_find_column_matches(sim_type       *sim,
+                        sim_clear_type *clear,
+                        size_t          x)
+{
+    sim_find_line_matches(sim, clear, x, 0, 0, 1, sim->height);
+}
+
+/*
+ * Work out the energy and score after a clear.
+ */
+static void
+sim_clear_reward(const sim_type       *sim,
+                 const sim_clear_type *clear,
+                 uint8_t              *energy,
+                 uint32_t             *score)
+{
+    int new_energy;
+
+    // TODO: More points/energy for kills from further away?
+    *score = sim->score + (clear->enemies_killed * clear->enemies_killed) * sim->chain * 100;
+    new_energy = sim->energy + (int)clear->enemies_killed * KILL_ENERGY - (int)clear->ships_killed * DIE_ENERGY;
+    new_energy = new_energy < 0 ? 0 : new_energy > MAX_ENERGY ? MAX_ENERGY : new_energy;
+
+    new_energy += clear->match_score * MATCH_ENERGY;
+    *energy = new_energy > MAX_ENERGY ? MAX_ENERGY : (uint8_t)new_energy;
+}
+
+static inline void
+sim_mark_gap(sim_type *sim,
+             size_t    x,
+             size_t    y)
+{
+    if (sim->gap_bottoms[x] < y + 1) {
+        sim->gap_bottoms[x] = (uint32_t)(y + 1);
+    }
+    sim_lines_add(&sim->gap_columns, x);
+}
+
+/*
+ * Find what a check needs to clear on a bitboard-sized board.
+ */
+static void
+sim_find_clear_bitboard(sim_type       *sim,
+                        sim_clear_type *clear)
+{
+    bitboard_type lines;
+    bitboard_type columns;
+    size_t x;
+    tile_type tile;
+
+    // A new shot needs a changed tile somewhere in its column, and a new run
+    // needs one somewhere along its row or column.
+    columns = bitboard_columns(sim->dirty);
+    lines = bitboard_rows(sim->dirty) | columns;
+
+    // Check for shots landing.
+    for (x = 0; x < sim->width; x++) {
+        if (columns & BITBOARD_CELL(x, 0)) {
+            sim_find_shots(sim, x, clear);
+        }
+    }
+
+    // Check for matching runs, a tile type at a time, skipping types that
+    // have no changed tiles.
+    for (tile = 0; tile < TILE_COUNT; tile++) {
+        if (sim->tile_masks[tile] & sim->dirty) {
+            sim_find_matches(sim->tile_masks[tile] & lines, clear);
+        }
+    }
+    sim->dirty = 0;
+}
+
+/*
+ * Find what a check needs to clear on a large board, a changed line at a
+ * time.
+ */
+static void
+sim_find_clear_lines(sim_type       *sim,
+                     sim_clear_type *clear)
+{
+    size_t i;
+
+    for (i = 0; i < sim->dirty_columns.count; i++) {
+        sim_find_shots(sim, sim->dirty_columns.list[i], clear);
+        sim_find_column_matches(sim, clear, sim->dirty_columns.list[i]);
+    }
+    for (i = 0; i < sim->dirty_rows.count; i++) {
+        sim_find_row_matches(sim, clear, sim->dirty_rows.list[i]);
+    }
+    sim_lines_clear(&sim->dirty_columns);
+    sim_lines_clear(&sim->dirty_rows);
+}
+
+
+/*
+ * See sim.h for details.
+ */
+bool
+sim_check_board(sim_type *sim)
+{
+    sim_clear_type clear = { 0 };
+    bitboard_type sweep;
+    tile_type tile;
+    unsigned int index;
+    size_t i;
+    bool updated;
+
+    if (sim->bitboard) {
+        sim_find_clear_bitboard(sim, &clear);
+    } else {
+        sim_find_clear_lines(sim, &clear);
+    }
+
+    if (clear.enemies_killed > 0) {
+        sim_raise_event(sim, SIM_EVENT_SHOOT);
+    }
+    if (clear.ships_killed > 0) {
+        sim_raise_event(sim, SIM_EVENT_ENEMY_SHOOT);
+    }
+    if (clear.match_score > 0) {
+        sim_raise_event(sim, SIM_EVENT_MATCH);
+    }
+
+    sim_clear_reward(sim, &clear, &sim->energy, &sim->score);
+
+    // Mark-and-sweep the tiles so that if there are multiple matches/shots involving the same tiles
+    // we get them all.
+    if (sim->bitboard) {
+        for (tile = 0; tile < TILE_COUNT; tile++) {
+            sim->tile_masks[tile] &= ~clear.erase_tiles;
+        }
+        for (sweep = clear.erase_tiles; sweep != 0; sweep &= sweep - 1) {
+            index = bitboard_first(sweep);
+            sim->tiles[sim_index(sim, index % BITBOARD_SIZE, index / BITBOARD_SIZE)] = TILE_EMPTY;
+            sim_mark_gap(sim, index % BITBOARD_SIZE, index / BITBOARD_SIZE);
+        }
+        updated = clear.erase_tiles != 0;
+    } else {
+        for (i = 0; i < sim->cleared_count; i++) {
+            sim->tiles[sim->cleared[i]] = TILE_EMPTY;
+            sim->erase[sim->cleared[i]] = 0;
+            sim_mark_gap(sim, sim->cleared[i] / sim->height, sim->cleared[i] % sim->height);
+        }
+        updated = sim->cleared_count != 0;
+        sim->cleared_count = 0;
+    }
+
+    if (updated) {
+        sim->changes++;
+    }
+    return updated;
+}
+
+
+/*
+ * See sim.h for details.
+ */
+void
+sim_evaluate_move(sim_type           *sim,
+                  coord_type          a,
+                  coord_type          b,
+                  sim_move_eval_type *eval)
+{
+    sim_clear_type clear = { 0 };
+    size_t index_a = sim_index(sim, a.x, a.y);
+    size_t index_b = sim_index(sim, b.x, b.y);
+    tile_type tile_a = (tile_type)sim->tiles[index_a];
+    tile_type tile_b = (tile_type)sim->tiles[index_b];
+    size_t i;
+
+    if (tile_a != tile_b) {
+        sim->tiles[index_a] = (uint8_t)tile_b;
+        sim->tiles[index_b] = (uint8_t)tile_a;
+
+        // Only the swapped columns can have new shots in them, and only the
+        // swapped rows and columns new runs.
+        sim_find_shots(sim, a.x, &clear);
+        if (b.x != a.x) {
+            sim_find_shots(sim, b.x, &clear);
+        }
+
+        if (sim->bitboard) {
+            // What's more, only the two swapped tile types can have formed
+            // new runs. Cells are only bitboard bits on boards that fit one.
+            bitboard_type swapped = BITBOARD_CELL(a.x, a.y) | BITBOARD_CELL(b.x, b.y);
+
+            sim_find_matches(sim->tile_masks[tile_a] ^ swapped, &clear);
+            sim_find_matches(sim->tile_masks[tile_b] ^ swapped, &clear);
+        } else {
+            sim_find_row_matches(sim, &clear, a.y);
+            sim_find_column_matches(sim, &clear, a.x);
+            if (b.y != a.y) {
+                sim_find_row_matches(sim, &clear, b.y);
+            }
+            if (b.x != a.x) {
+                sim_find_column_matches(sim, &clear, b.x);
+            }
+        }
+
+        sim->tiles[index_a] = (uint8_t)tile_a;
+        sim->tiles[index_b] = (uint8_t)tile_b;
+    }
+
+    sim_clear_reward(sim, &clear, &eval->energy, &eval->score);
+    eval->energy = eval->energy > MOVE_ENERGY ? eval->energy - MOVE_ENERGY : 0;
+    eval->score -= sim->score;
+    eval->enemies_killed = clear.enemies_killed;
+    eval->ships_killed = clear.ships_killed;
+
+    if (sim->bitboard) {
+        eval->cleared = bitboard_count(clear.erase_tiles);
+    } else {
+        eval->cleared = (unsigned int)sim->cleared_count;
+        for (i = 0; i < sim->cleared_count; i++) {
+            sim->erase[sim->cleared[i]] = 0;
+        }
+        sim->cleared_count = 0;
+    }
+}
+
+
+/*
+ * See sim.h for details.
+ */
+bool
+sim_init(sim_type          *sim,
+         size_t             width,
+         size_t             height,
+         uint64_t           seed,
+         sim_event_fn_type  event_cb,
+         void              *event_ctx)
+{
+    bool updated;
+    size_t x;
+    size_t y;
+
+    *sim = (sim_type){ 0 };
+    if (width == 0 || height == 0 || width * height < 2 ||
+        width > MAX_BOARD_SIZE || height > MAX_BOARD_SIZE) {
+        return false;
+    }
+
+    sim->width = width;
+    sim->height = height;
+    sim->bitboard = width <= BITBOARD_SIZE && height <= BITBOARD_SIZE;
+    sim->memory_size = sim_layout(sim, NULL);
+    sim->memory = calloc(1, sim->memory_size);
+    if (sim->memory == NULL) {
+        return false;
+    }
+    (void)sim_layout(sim, sim->memory);
+
+    random_seed(&sim->random, seed);
+    (void)sampler_build(&sim->tile_sampler, sim_default_tile_weights, TILE_COUNT);
+
+    // Set up board.
+    sim_fill_next_row(sim);
+    for (x = 0; x < sim->width; x++) {
+        for (y = 0; y < sim->height; y++) {
+            sim_set_tile(sim, x, y, sim_random_tile(sim));
+        }
+    }
+
+    do {
+        updated = false;
+
+        // Check for matches
+        (void)sim_check_board(sim);
+
+        // Fill in any gaps, without dropping.
+        for (x = 0; x < sim->width; x++) {
+            for (y = 0; y < sim->gap_bottoms[x]; y++) {
+                if (sim_tile(sim, x, y) == TILE_EMPTY) {
+                    updated = true;
+                    sim_set_tile(sim, x, y, sim_random_tile(sim));
+                }
+            }
+            sim->gap_bottoms[x] = 0;
+        }
+        sim_lines_clear(&sim->gap_columns);
+    } while (updated);
+
+    sim->chain = 1;
+    sim->score = 0;
+    sim->energy = MAX_ENERGY;
+
+    // Only hook up events once setup is done, so they aren't raised for the
+    // matches cleared while filling the board.
+    sim->event_cb = event_cb;
+    sim->event_ctx = event_ctx;
+
+    return true;
+}
+
+
+/*
+ * See sim.h for details.
+ */
+bool
+sim_clone(sim_type       *sim,
+          const sim_type *src)
+{
+    *sim = *src;
+    sim->memory = malloc(src->memory_size);
+    if (sim->memory == NULL) {
+        return false;
+    }
+    (void)sim_layout(sim, sim->memory);
+    memcpy(sim->memory, src->memory, src->memory_size);
+
+    return true;
+}
+
+
+/*
+ * See sim.h for details.
+ */
+void
+sim_copy(sim_type       *dst,
+         const sim_type *src)
+{
+    void *memory = dst->memory;
+
+    *dst = *src;
+    dst->memory = memory;
+    (void)sim_layout(dst, memory);
+    memcpy(memory, src->memory, src->memory_size);
+}
+
+
+/*
+ * See sim.h for details.
+ */
+void
+sim_destroy(sim_type *sim)
+{
+    free(sim->memory);
+    *sim = (sim_type){ 0 };
+}
+
+
+/*
+ * See sim.h for details.
+ */
+bool
+sim_apply_move(sim_type   *sim,
+               coord_type  a,
+               coord_type  b)
+{
+    tile_type tmp = sim_tile(sim, a.x, a.y);
+    bool updated;
+
+    sim_set_tile(sim, a.x, a.y, sim_tile(sim, b.x, b.y));
+    sim_set_tile(sim, b.x, b.y, tmp);
+    updated = sim_check_board(sim);
+
+    // Lose the energy for moving after checking the board, so that if the player has less
+    // energy than it takes to move, they can avoid dying if they make a move that gains
+    // energy.
+    sim_lose_energy(sim, MOVE_ENERGY);
+
+    return updated;
+}
+
+
+static unsigned int
+sim_drop_column(sim_type *sim,
+                size_t    x,
+                uint16_t *falls)
+{
+    int y;
+    unsigned int gap;
+    uint16_t *column_falls = falls != NULL ? &falls[sim_index(sim, x, 0)] : NULL;
+    uint8_t drawn[SIM_DRAW_CHUNK];
+    size_t drawn_count = 0;
+    size_t drawn_used = 0;
+
+    // Working up from the lowest gap, every tile falls by the number of gaps
+    // found below it so far. Each cell a tile leaves is filled in later on,
+    // either by a tile from further up or a new one.
+    gap = 0;
+    for (y = (int)sim->gap_bottoms[x] - 1; y >= 0; y--) {
+        if (sim_tile(sim, x, y) == TILE_EMPTY) {
+            gap++;
+        } else if (gap > 0) {
+            sim_set_tile(sim, x, y + gap, sim_tile(sim, x, y));
+            if (column_falls != NULL) {
+                column_falls[y + gap] = (uint16_t)gap;
+            }
+        }
+    }
+
+    // Feed in new tiles, the first of them from the next row. The tiles that
+    // replace it are drawn a chunk at a time.
+    for (y = (int)gap - 1; y >= 0; y--) {
+        if (drawn_used == drawn_count) {
+            drawn_count = (size_t)y + 1 < SIM_DRAW_CHUNK ? (size_t)y + 1 : SIM_DRAW_CHUNK;
+            drawn_used = 0;
+            sampler_fill(&sim->tile_sampler, &sim->random, drawn, drawn_count);
+        }
+        sim_set_tile(sim, x, y, sim->next_row[x]);
+        sim->next_row[x] = drawn[drawn_used++];
+        if (column_falls != NULL) {
+            column_falls[y] = (uint16_t)gap;
+        }
+    }
+
+    sim->gap_bottoms[x] = 0;
+
+    return gap;
+}
+
+
+/*
+ * See sim.h for details.
+ */
+unsigned int
+sim_drop(sim_type *sim,
+         uint16_t *falls)
+{
+    size_t x;
+    size_t i;
+    unsigned int gap;
+    unsigned int furthest = 0;
+
+    if (falls != NULL) {
+        memset(falls, 0, sim->width * sim->height * sizeof(*falls));
+    }
+
+    if (sim->bitboard) {
+        // Few enough columns to just go through them in order.
+        for (x = 0; x < sim->width; x++) {
+            if (sim->gap_bottoms[x] > 0) {
+                gap = sim_drop_column(sim, x, falls);
+                furthest = gap > furthest ? gap : furthest;
+            }
+        }
+    } else {
+        for (i = 0; i < sim->gap_columns.count; i++) {
+            gap = sim_drop_column(sim, sim->gap_columns.list[i], falls);
+            furthest = gap > furthest ? gap : furthest;
+        }
+    }
+    sim_lines_clear(&sim->gap_columns);
+
+    return furthest;
+}
+
+
+/*
+ * See sim.h for details.
+ */
+bool
+sim_settle(sim_type *sim)
+{
+    bool updated;
+
+    // If we found new matches, increase the chain, otherwise reset it.
+    updated = sim_check_board(sim);
+    if (updated) {
+        sim->chain += 1;
+    } else {
+        sim->chain = 1;
+    }
+
+    return updated;
+}
+
+
+/*
+ * See sim.h for details.
+ */
+bool
+sim_step(sim_type *sim)
+{
+    (void)sim_drop(sim, NULL);
+    return sim_settle(sim);
+}
+
+
+/*
+ * See sim.h for details.
+ */
+void
+sim_resolve(sim_type *sim)
+{
+    while (sim_step(sim)) {
+    }
+}
+
+
+/*
+ * See sim.h for details.
+ */
+bool
+sim_set_tile_weights(sim_type       *sim,
+                     const uint32_t *weights)
+{
+    return sampler_build(&sim->tile_sampler, weights, TILE_COUNT);
+}
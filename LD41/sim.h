@@ -0,0 +1,226 @@
+#ifndef __SIM_H__
+#define __SIM_H__
+
+
+/*
+ * The board rules, independent of rendering, sound and timing. This depends
+ * only on the C standard library, so it can be built and run headless.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "random.h"
+#include "sampler.h"
+
+
+// The usual board, which fits in a bitboard so gets the fast paths.
+#define DEFAULT_BOARD_WIDTH 8
+#define DEFAULT_BOARD_HEIGHT 8
+
+// Largest supported width or height, so fall distances fit in 16 bits.
+#define MAX_BOARD_SIZE 4096
+
+#define MAX_ENERGY 100
+#define MOVE_ENERGY 12
+#define KILL_ENERGY 25
+#define DIE_ENERGY 35
+#define MATCH_ENERGY 3
+#define TICK_ENERGY 1
+
+typedef enum tile {
+    TILE_SHIP,
+    TILE_LASER,
+    TILE_ENEMY_LASER,
+    TILE_ENEMY,
+    TILE_ASTEROID_1,
+    TILE_ASTEROID_2,
+    TILE_ASTEROID_3,
+    TILE_BOMB,
+    TILE_EMPTY,
+    TILE_COUNT = TILE_EMPTY,
+} tile_type;
+
+typedef struct coord {
+    size_t x;
+    size_t y;
+} coord_type;
+
+typedef enum {
+    SIM_EVENT_SHOOT,       // The player shot at least one enemy.
+    SIM_EVENT_ENEMY_SHOOT, // An enemy shot at least one of the player's ships.
+    SIM_EVENT_MATCH,       // At least one run of matching tiles was cleared.
+} sim_event_type;
+
+typedef void(*sim_event_fn_type)(sim_event_type  event,
+                                 void           *ctx);
+
+// A set of rows or columns, as flags for lookup plus a list for iterating.
+typedef struct sim_lines {
+    uint8_t  *flags;
+    uint32_t *list;
+    size_t    count;
+} sim_lines_type;
+
+/*
+ * Boards of up to BITBOARD_SIZE in each direction are checked with bitboards.
+ * Larger boards are checked a line at a time, tracking changed lines rather
+ * than cells. Either way, the work done after a move grows with what the move
+ * changed rather than with the size of the board.
+ *
+ * All the per-cell state lives in one allocation, so a sim must be set up
+ * with sim_init or sim_clone, copied with sim_copy and freed with
+ * sim_destroy.
+ */
+typedef struct sim {
+    size_t            width;
+    size_t            height;
+    bool              bitboard;               // Small enough for the bitboard fast paths.
+    uint8_t          *tiles;                  // The tile_type in each cell, a column at a time. See sim_tile.
+    uint8_t          *next_row;               // The next tile to drop into each column.
+    bitboard_type     tile_masks[TILE_COUNT]; // Bitboard only: which cells hold each tile type.
+    bitboard_type     dirty;                  // Bitboard only: cells changed since the board was last checked.
+    sim_lines_type    dirty_rows;             // Large boards only: rows changed since the last check.
+    sim_lines_type    dirty_columns;          // Large boards only: columns changed since the last check.
+    uint8_t          *erase;                  // Large boards only: cells the current check will clear.
+    uint32_t         *cleared;                // Large boards only: the same cells, as a list.
+    size_t            cleared_count;
+    uint32_t         *gap_bottoms;            // One past the lowest gap in each column, or 0.
+    sim_lines_type    gap_columns;            // Columns with gaps waiting to be dropped into.
+    void             *memory;
+    size_t            memory_size;
+    uint64_t          changes;                // Counts tile changes, so callers can tell when the board is untouched.
+    uint8_t           energy;
+    uint32_t          score;
+    uint8_t           chain;
+    random_state_type random;                 // Source of new tiles.
+    sampler_type      tile_sampler;           // Chooses the type of each new tile.
+    sim_event_fn_type event_cb;               // May be NULL.
+    void             *event_ctx;
+} sim_type;
+
+// What a move would do on its own, before any cascade.
+typedef struct sim_move_eval {
+    unsigned int cleared;        // Tiles cleared by matches and shots.
+    unsigned int enemies_killed;
+    unsigned int ships_killed;
+    uint8_t      energy;         // Energy after the move, including its cost.
+    uint32_t     score;          // Score gained.
+} sim_move_eval_type;
+
+
+/*
+ * How often each type of tile turns up on a new board, relative to the
+ * others. A sim starts out with these, and sim_set_tile_weights swaps them.
+ */
+extern const uint32_t sim_default_tile_weights[TILE_COUNT];
+
+
+static inline size_t
+sim_index(const sim_type *sim,
+          size_t          x,
+          size_t          y)
+{
+    return x * sim->height + y;
+}
+
+static inline tile_type
+sim_tile(const sim_type *sim,
+         size_t          x,
+         size_t          y)
+{
+    return (tile_type)sim->tiles[sim_index(sim, x, y)];
+}
+
+
+/*
+ * Set up a new game, with a board that has no matches or shots on it. The
+ * same seed always gives the same game for the same moves. No events are
+ * raised during setup. Returns false if the size isn't supported or memory
+ * runs out.
+ */
+bool sim_init(sim_type *sim, size_t width, size_t height, uint64_t seed, sim_event_fn_type event_cb, void *event_ctx);
+
+/*
+ * Set up sim as a copy of src, allocating its own memory.
+ */
+bool sim_clone(sim_type *sim, const sim_type *src);
+
+/*
+ * Copy src over dst, which must already be set up with the same size.
+ */
+void sim_copy(sim_type *dst, const sim_type *src);
+
+void sim_destroy(sim_type *sim);
+
+/*
+ * Swap two adjacent tiles, clear anything the swap lines up and charge the
+ * player for the move. Returns true if tiles were cleared, in which case the
+ * board must be stepped with sim_step until it settles.
+ */
+bool sim_apply_move(sim_type *sim, coord_type a, coord_type b);
+
+/*
+ * Drop every tile above a gap straight down to where it lands, in one pass
+ * per column with gaps, and feed new tiles in at the top of each column,
+ * starting with the column's tile from the next row. New tiles fall as far as
+ * the tiles they land on, as if they had been waiting above the board.
+ *
+ * If falls is not NULL, it is set to how many rows the tile now in each cell
+ * (indexed by sim_index) fell, 0 for tiles that didn't move, so the drop can
+ * be animated. Returns the furthest any tile fell.
+ */
+unsigned int sim_drop(sim_type *sim, uint16_t *falls);
+
+/*
+ * Check a board that has just been dropped for new matches and shots,
+ * extending the chain if there were any and resetting it if not. Returns true
+ * if tiles were cleared, so there is more dropping to be done.
+ */
+bool sim_settle(sim_type *sim);
+
+/*
+ * Drop and then settle the board, for when the drop doesn't need animating.
+ * Returns true while there is still movement to be done.
+ */
+bool sim_step(sim_type *sim);
+
+/*
+ * Step the board until it settles.
+ */
+void sim_resolve(sim_type *sim);
+
+/*
+ * Work out what swapping two adjacent tiles would do, without changing the
+ * board. The board must be settled, with no matches or shots already on it.
+ * The swapped tiles (and on large boards, the sim's scratch space) are
+ * written while they are checked, so the sim must not be shared with another
+ * thread during the call.
+ */
+void sim_evaluate_move(sim_type *sim, coord_type a, coord_type b, sim_move_eval_type *eval);
+
+/*
+ * Clear any matches and shots on the board. Returns true if any tiles were
+ * cleared.
+ *
+ * Every check clears everything it finds, so anything new must involve a
+ * tile placed since the last check. Only the rows and columns holding those
+ * tiles are searched, which gives the same result as searching the whole
+ * board as long as tiles are only changed through the sim functions.
+ */
+bool sim_check_board(sim_type *sim);
+
+/*
+ * Change how often each type of tile (indexed by tile_type) is fed in from
+ * now on, e.g. to make a game harder as it goes on. Tiles already on the
+ * board and in the next row are left alone. Returns false, keeping the old
+ * weights, if the weights are all 0 or too large.
+ */
+bool sim_set_tile_weights(sim_type *sim, const uint32_t *weights);
+
+void sim_lose_energy(sim_type *sim, uint8_t damage);
+
+
+#endif /* __SIM_H__ */
@@ -0,0 +1,324 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+#include "task_pool.h"
+
+#define TASK_QUEUE_INITIAL_SIZE 64
+
+typedef struct task {
+    task_fn_type  fn;
+    void         *ctx;
+} task_type;
+
+// A ring buffer of tasks. The owning worker takes from the back, thieves
+// take from the front.
+typedef struct task_queue {
+    platform_mutex_handle  lock;
+    task_type             *tasks;
+    size_t                 size;
+    size_t                 head;
+    size_t                 count;
+} task_queue_type;
+
+typedef struct task_worker {
+    struct task_pool       *pool;
+    platform_thread_handle  thread;
+    unsigned int            index;
+    task_queue_type         queue;
+} task_worker_type;
+
+typedef struct task_pool {
+    task_worker_type      *workers;
+    unsigned int           worker_count;
+    unsigned int           next_queue;
+    platform_mutex_handle  lock;      // Protects the counts and flag below.
+    platform_cond_handle   work_cond; // Signalled when tasks are queued or the pool is stopping.
+    platform_cond_handle   idle_cond; // Signalled when the last pending task finishes.
+    int                    queued;    // Tasks waiting in queues. May briefly dip below zero.
+    size_t                 pending;   // Tasks submitted but not yet finished.
+    bool                   stop;
+} task_pool_type;
+
+
+/*
+ * Add a task to the back of the queue. Returns false if the queue is full
+ * and can't grow.
+ */
+static bool
+task_queue_push(task_queue_type *queue,
+                task_type        task)
+{
+    task_type *tasks;
+    size_t     size;
+    size_t     i;
+
+    platform_mutex_lock(queue->lock);
+
+    if (queue->count == queue->size) {
+        size = queue->size == 0 ? TASK_QUEUE_INITIAL_SIZE : queue->size * 2;
+        tasks = malloc(size * sizeof(*tasks));
+        if (tasks == NULL) {
+            platform_mutex_unlock(queue->lock);
+            return false;
+        }
+        for (i = 0; i < queue->count; i++) {
+            tasks[i] = queue->tasks[(queue->head + i) % queue->size];
+        }
+        free(queue->tasks);
+        queue->tasks = tasks;
+        queue->size = size;
+        queue->head = 0;
+    }
+
+    queue->tasks[(queue->head + queue->count) % queue->size] = task;
+    queue->count++;
+
+    platform_mutex_unlock(queue->lock);
+
+    return true;
+}
+
+
+static bool
+task_queue_take(task_queue_type *queue,
+                bool             steal,
+                task_type       *task)
+{
+    bool found = false;
+
+    platform_mutex_lock(queue->lock);
+
+    if (queue->count > 0) {
+        if (steal) {
+            *task = queue->tasks[queue->head];
+            queue->head = (queue->head + 1) % queue->size;
+        } else {
+            *task = queue->tasks[(queue->head + queue->count - 1) % queue->size];
+        }
+        queue->count--;
+        found = true;
+    }
+
+    platform_mutex_unlock(queue->lock);
+
+    return found;
+}
+
+
+/*
+ * Take a task from the worker's own queue, or failing that steal one from
+ * another worker.
+ */
+static bool
+task_pool_take(task_pool_type *pool,
+               unsigned int    index,
+               task_type      *task)
+{
+    unsigned int i;
+    bool         found;
+
+    found = task_queue_take(&pool->workers[index].queue, false, task);
+    for (i = 1; !found && i < pool->worker_count; i++) {
+        found = task_queue_take(&pool->workers[(index + i) % pool->worker_count].queue, true, task);
+    }
+
+    if (found) {
+        platform_mutex_lock(pool->lock);
+        pool->queued--;
+        platform_mutex_unlock(pool->lock);
+    }
+
+    return found;
+}
+
+
+static int
+task_pool_worker_main(task_worker_type *worker)
+{
+    task_pool_type *pool = worker->pool;
+    task_type       task;
+
+    for (;;) {
+        if (task_pool_take(pool, worker->index, &task)) {
+            task.fn(task.ctx);
+
+            platform_mutex_lock(pool->lock);
+            pool->pending--;
+            if (pool->pending == 0) {
+                platform_cond_broadcast(pool->idle_cond);
+            }
+            platform_mutex_unlock(pool->lock);
+            continue;
+        }
+
+        platform_mutex_lock(pool->lock);
+        while (pool->queued <= 0 && !pool->stop) {
+            platform_cond_wait(pool->work_cond, pool->lock);
+        }
+        if (pool->stop && pool->queued <= 0) {
+            platform_mutex_unlock(pool->lock);
+            break;
+        }
+        platform_mutex_unlock(pool->lock);
+    }
+
+    return 0;
+}
+
+
+/*
+ * Stop and join the first started workers, and free whatever of the pool
+ * has been set up.
+ */
+static void
+task_pool_free(task_pool_type *pool,
+               unsigned int    started)
+{
+    unsigned int i;
+
+    if (started > 0) {
+        platform_mutex_lock(pool->lock);
+        pool->stop = true;
+        platform_cond_broadcast(pool->work_cond);
+        platform_mutex_unlock(pool->lock);
+    }
+
+    for (i = 0; i < started; i++) {
+        (void)platform_thread_join(pool->workers[i].thread);
+    }
+    for (i = 0; i < pool->worker_count; i++) {
+        if (pool->workers[i].queue.lock != NULL) {
+            platform_mutex_destroy(pool->workers[i].queue.lock);
+        }
+        free(pool->workers[i].queue.tasks);
+    }
+
+    if (pool->idle_cond != NULL) {
+        platform_cond_destroy(pool->idle_cond);
+    }
+    if (pool->work_cond != NULL) {
+        platform_cond_destroy(pool->work_cond);
+    }
+    if (pool->lock != NULL) {
+        platform_mutex_destroy(pool->lock);
+    }
+    free(pool->workers);
+    free(pool);
+}
+
+
+/*
+ * See task_pool.h for details.
+ */
+task_pool_handle
+task_pool_create(unsigned int threads)
+{
+    task_pool_handle pool;
+    unsigned int     i;
+
+    if (threads == 0) {
+        threads = platform_cpu_count();
+    }
+
+    pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pool->workers = calloc(threads, sizeof(*pool->workers));
+    pool->lock = platform_mutex_create();
+    pool->work_cond = platform_cond_create();
+    pool->idle_cond = platform_cond_create();
+    if (pool->workers == NULL || pool->lock == NULL || pool->work_cond == NULL || pool->idle_cond == NULL) {
+        task_pool_free(pool, 0);
+        return NULL;
+    }
+
+    pool->worker_count = threads;
+    for (i = 0; i < threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        pool->workers[i].queue.lock = platform_mutex_create();
+        if (pool->workers[i].queue.lock == NULL) {
+            task_pool_free(pool, 0);
+            return NULL;
+        }
+    }
+    for (i = 0; i < threads; i++) {
+        pool->workers[i].thread = platform_thread_create((platform_thread_fn_type)&task_pool_worker_main,
+                                                         &pool->workers[i]);
+        if (pool->workers[i].thread == NULL) {
+            task_pool_free(pool, i);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+
+void
+task_pool_destroy(task_pool_handle pool)
+{
+    task_pool_free(pool, pool->worker_count);
+}
+
+
+unsigned int
+task_pool_threads(task_pool_handle pool)
+{
+    return pool->worker_count;
+}
+
+
+/*
+ * See task_pool.h for details.
+ */
+bool
+task_pool_submit(task_pool_handle  pool,
+                 task_fn_type      fn,
+                 void             *ctx)
+{
+    task_type    task = { fn, ctx };
+    unsigned int index;
+
+    platform_mutex_lock(pool->lock);
+    index = pool->next_queue;
+    pool->next_queue = (pool->next_queue + 1) % pool->worker_count;
+    pool->pending++;
+    platform_mutex_unlock(pool->lock);
+
+    if (!task_queue_push(&pool->workers[index].queue, task)) {
+        platform_mutex_lock(pool->lock);
+        pool->pending--;
+        if (pool->pending == 0) {
+            platform_cond_broadcast(pool->idle_cond);
+        }
+        platform_mutex_unlock(pool->lock);
+        return false;
+    }
+
+    platform_mutex_lock(pool->lock);
+    pool->queued++;
+    platform_cond_signal(pool->work_cond);
+    platform_mutex_unlock(pool->lock);
+
+    return true;
+}
+
+
+/*
+ * See task_pool.h for details.
+ */
+void
+task_pool_wait(task_pool_handle pool)
+{
+    platform_mutex_lock(pool->lock);
+    while (pool->pending > 0) {
+        platform_cond_wait(pool->idle_cond, pool->lock);
+    }
+    platform_mutex_unlock(pool->lock);
+}
@@ -0,0 +1,39 @@
+#ifndef __TASK_POOL_H__
+#define __TASK_POOL_H__
+
+
+/*
+ * A fixed set of worker threads running submitted tasks. Each worker has its
+ * own queue; a worker with nothing left to do steals from the others, so
+ * uneven tasks still keep every core busy.
+ */
+
+#include <stdbool.h>
+
+typedef struct task_pool *task_pool_handle;
+
+typedef void(*task_fn_type)(void *ctx);
+
+
+/*
+ * Start a pool with the given number of threads, or one per core if 0.
+ * Returns NULL if the pool or any of its threads can't be set up.
+ */
+task_pool_handle task_pool_create(unsigned int threads);
+void task_pool_destroy(task_pool_handle pool);
+
+unsigned int task_pool_threads(task_pool_handle pool);
+
+/*
+ * Queue a task. Returns false, and the task isn't run, if there's no memory
+ * to queue it.
+ */
+bool task_pool_submit(task_pool_handle pool, task_fn_type fn, void *ctx);
+
+/*
+ * Block until every submitted task has finished.
+ */
+void task_pool_wait(task_pool_handle pool);
+
+
+#endif /* __TASK_POOL_H__ */
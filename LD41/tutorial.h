@@ -3,6 +3,7 @@
 
 #include <SDL.h>
 
+#include "asset.h"
 #include "font.h"
 #include "gamestate.h"
 #include "main.h"
@@ -11,33 +12,44 @@
 #define NUM_SCREENS 4
 
 typedef struct tutorial_info {
-    SDL_Texture *screens[NUM_SCREENS];
+    asset_handle screens[NUM_SCREENS];
     size_t cur_screen;
-    float time;
+    uint64_t ticks;
 } tutorial_info_type;
 
 static void
 tutorial_update(gamestate_mgr_handle mgr,
-                float frametime,
                 tutorial_info_type *tutorial)
 {
-    tutorial->time += frametime;
+    tutorial->ticks++;
 }
 
 static void
 tutorial_draw(SDL_Renderer *renderer,
+              float alpha,
               const tutorial_info_type *tutorial)
 {
     SDL_Rect rect;
 
-    SDL_Texture *screen = tutorial->screens[tutorial->cur_screen];
-        
+    SDL_Texture *screen = asset_texture(tutorial->screens[tutorial->cur_screen]);
+
+    // Still loading.
+    if (screen == NULL) {
+        return;
+    }
+
     SDL_QueryTexture(screen, NULL, NULL, &rect.w, &rect.h);
     rect.x = (main_screen_width() - rect.w) / 2;
     rect.y = (main_screen_height() - rect.h) / 2;
     SDL_RenderCopy(renderer, screen, NULL, &rect);
 }
 
+static uint64_t
+tutorial_idle(const tutorial_info_type *tutorial)
+{
+    return GAMESTATE_IDLE_FOREVER;
+}
+
 static void
 tutorial_event(gamestate_mgr_handle mgr,
                SDL_Event *e,
@@ -58,7 +70,7 @@ static void
 tutorial_cleanup(tutorial_info_type *tutorial)
 {
     for (size_t i = 0; i < NUM_SCREENS; i++) {
-        free_texture(tutorial->screens[i]);
+        asset_release(tutorial->screens[i]);
     }
     
     free(tutorial);
@@ -69,20 +81,24 @@ tutorial_init(SDL_Renderer *renderer)
 {
     gamestate_type gamestate;
     tutorial_info_type *tutorial;
+    PROFILE_BEGIN(init, "tutorial.init");
 
     tutorial = calloc(1, sizeof(*tutorial));
-    tutorial->screens[0] = load_texture("media/tutorial/tut1.png", renderer);
-    tutorial->screens[1] = load_texture("media/tutorial/tut2.png", renderer);
-    tutorial->screens[2] = load_texture("media/tutorial/tut3.png", renderer);
-    tutorial->screens[3] = load_texture("media/tutorial/tut4.png", renderer);
+    tutorial->screens[0] = asset_texture_acquire(renderer, "media/tutorial/tut1.png");
+    tutorial->screens[1] = asset_texture_acquire(renderer, "media/tutorial/tut2.png");
+    tutorial->screens[2] = asset_texture_acquire(renderer, "media/tutorial/tut3.png");
+    tutorial->screens[3] = asset_texture_acquire(renderer, "media/tutorial/tut4.png");
     
     gamestate.update_cb = (gamestate_update_fn_type)&tutorial_update;
     gamestate.draw_cb = (gamestate_draw_fn_type)&tutorial_draw;
     gamestate.event_cb = (gamestate_event_fn_type)&tutorial_event;
     gamestate.cleanup_cb = (gamestate_cleanup_fn_type)&tutorial_cleanup;
+    gamestate.idle_cb = (gamestate_idle_fn_type)&tutorial_idle;
     gamestate.flags = GAMESTATE_FLAG_DEFAULT;
+    gamestate.name = "tutorial";
     gamestate.ctx = tutorial;
 
+    PROFILE_END(init);
     return gamestate;
 }
 
@@ -47,27 +47,4 @@ draw_rotated_rect(SDL_Renderer *renderer,
     rotate_point(rect->x, rect->y, angle, origin_x, origin_y, &points[4].x, &points[4].y);
 
     (void)SDL_RenderDrawLines(renderer, points, 5);
-}
-
-
-/*
- * See utils.h for details.
- */
-unsigned int
-random_range(unsigned int min, unsigned int max) {
-    int r;
-    const unsigned int range = 1 + max - min;
-    const unsigned int buckets = RAND_MAX / range;
-    const unsigned int limit = buckets * range;
-
-
-    /* Create equal size buckets all in a row, then fire randomly towards
-    * the buckets until you land in one of them. All buckets are equally
-    * likely. If you land off the end of the line of buckets, try again. */
-    do
-    {
-        r = rand();
-    } while (r >= limit);
-
-    return min + (r / buckets);
 }
\ No newline at end of file
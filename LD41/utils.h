@@ -53,11 +53,5 @@ draw_overlay(SDL_Renderer *renderer, int screen_width, int screen_height)
     SDL_RenderFillRect(renderer, &rect);
 }
 
-/*
-* Find a random number in the closed interval [min, max].
-* Assumes 0 <= max <= RAND_MAX
-*/
-unsigned int random_range(unsigned int min, unsigned int max);
-
 
 #endif /* __UTILS_H__ */
\ No newline at end of file
@@ -0,0 +1,383 @@
+/*
+ * Headless self-play benchmark for the board rules. Plays complete games
+ * (from a fresh board until the player runs out of energy) across all cores
+ * and reports throughput and per-move resolution times.
+ *
+ * Usage: LD41Bench [-g games] [-t threads] [-p random|greedy|mcts] [-s seed]
+ *                  [-b WIDTHxHEIGHT] [-r mcts rollouts per move]
+ *                  [-m mcts milliseconds per move]
+ *
+ * The mcts policy searches each move on every thread, so its games are
+ * played one at a time.
+ *
+ * Large boards (e.g. -b 1024x1024) make a stress test for the rules, showing
+ * where the matching, shot and drop code stops scaling.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcts.h"
+#include "move.h"
+#include "platform.h"
+#include "random.h"
+#include "sim.h"
+
+#define DEFAULT_GAMES 10000
+#define DEFAULT_MCTS_ROLLOUTS 2000
+#define DEFAULT_MCTS_TREES 16
+#define MAX_THREADS 256
+
+typedef struct bench_worker bench_worker_type;
+
+typedef void(*bench_policy_fn_type)(bench_worker_type *worker,
+                                    sim_type          *sim,
+                                    coord_type        *a,
+                                    coord_type        *b);
+
+typedef struct bench_policy {
+    const char           *name;
+    bench_policy_fn_type  fn;
+    bool                  parallel; // The policy uses every thread itself.
+} bench_policy_type;
+
+typedef struct bench_worker {
+    platform_thread_handle  thread;
+    bench_policy_fn_type    policy;
+    mcts_handle             mcts;
+    random_state_type       random;
+    uint64_t                seed;
+    size_t                  width;
+    size_t                  height;
+    unsigned int            first_game;
+    unsigned int            game_count;
+    uint64_t                moves;
+    uint64_t                cascades;
+    uint64_t                fallbacks; // Searches that failed, so greedy moves were played.
+    uint64_t               *move_times; // Nanoseconds to resolve each move.
+    size_t                  move_times_size;
+} bench_worker_type;
+
+
+static void
+bench_policy_random(bench_worker_type *worker,
+                    sim_type          *sim,
+                    coord_type        *a,
+                    coord_type        *b)
+{
+    a->x = random_range(&worker->random, 0, (unsigned int)sim->width - 1);
+    a->y = random_range(&worker->random, 0, (unsigned int)sim->height - 1);
+    *b = *a;
+
+    // Swap with a neighbour, going the other way at the edges and across if
+    // the board is only one tile high.
+    if (sim->height == 1 || (sim->width > 1 && random_range(&worker->random, 0, 1) == 0)) {
+        b->x = a->x < sim->width - 1 ? a->x + 1 : a->x - 1;
+    } else {
+        b->y = a->y < sim->height - 1 ? a->y + 1 : a->y - 1;
+    }
+}
+
+
+static void
+bench_policy_greedy(bench_worker_type *worker,
+                    sim_type          *sim,
+                    coord_type        *a,
+                    coord_type        *b)
+{
+    move_type move;
+
+    (void)worker;
+    (void)move_best(sim, &move, NULL);
+    *a = move.a;
+    *b = move.b;
+}
+
+
+static void
+bench_policy_mcts(bench_worker_type *worker,
+                  sim_type          *sim,
+                  coord_type        *a,
+                  coord_type        *b)
+{
+    move_type move;
+
+    if (!mcts_search(worker->mcts, sim, &move, NULL)) {
+        worker->fallbacks++;
+        bench_policy_greedy(worker, sim, a, b);
+        return;
+    }
+
+    *a = move.a;
+    *b = move.b;
+}
+
+
+static const bench_policy_type bench_policies[] = {
+    { "random", &bench_policy_random, false },
+    { "greedy", &bench_policy_greedy, false },
+    { "mcts",   &bench_policy_mcts,   true },
+};
+
+
+/*
+ * Returns false if there's no memory to record the time.
+ */
+static bool
+bench_record_move_time(bench_worker_type *worker,
+                       uint64_t           time)
+{
+    uint64_t *move_times;
+    size_t    new_size;
+
+    if (worker->moves == worker->move_times_size) {
+        new_size = worker->move_times_size == 0 ? 4096 : worker->move_times_size * 2;
+        move_times = realloc(worker->move_times, new_size * sizeof(*worker->move_times));
+        if (move_times == NULL) {
+            return false;
+        }
+        worker->move_times = move_times;
+        worker->move_times_size = new_size;
+    }
+
+    worker->move_times[worker->moves++] = time;
+
+    return true;
+}
+
+
+static int
+bench_worker_main(bench_worker_type *worker)
+{
+    sim_type     sim;
+    coord_type   a;
+    coord_type   b;
+    uint64_t     start;
+    uint64_t     game_seed;
+    uint8_t      chain;
+    bool         resolving;
+    unsigned int game;
+
+    for (game = worker->first_game; game < worker->first_game + worker->game_count; game++) {
+        // Seed each game from its number, so results don't depend on how
+        // games are shared out between threads.
+        game_seed = worker->seed + game * 0x9E3779B97F4A7C15ULL;
+        if (!sim_init(&sim, worker->width, worker->height, game_seed, NULL, NULL)) {
+            fprintf(stderr, "Failed to set up a %zux%zu board\n", worker->width, worker->height);
+            return 1;
+        }
+        random_seed(&worker->random, ~game_seed);
+
+        while (sim.energy > 0) {
+            worker->policy(worker, &sim, &a, &b);
+
+            start = platform_time_ns();
+            if (sim_apply_move(&sim, a, b)) {
+                worker->cascades++;
+
+                // Every step that finds new matches once the tiles have
+                // settled extends the chain.
+                do {
+                    chain = sim.chain;
+                    resolving = sim_step(&sim);
+                    if (sim.chain > chain) {
+                        worker->cascades++;
+                    }
+                } while (resolving);
+            }
+            if (!bench_record_move_time(worker, platform_time_ns() - start)) {
+                fprintf(stderr, "Out of memory recording move times\n");
+                sim_destroy(&sim);
+                return 1;
+            }
+        }
+
+        sim_destroy(&sim);
+    }
+
+    return 0;
+}
+
+
+static int
+bench_compare_times(const void *a,
+                    const void *b)
+{
+    uint64_t time_a = *(const uint64_t *)a;
+    uint64_t time_b = *(const uint64_t *)b;
+
+    return (time_a > time_b) - (time_a < time_b);
+}
+
+
+static void
+bench_usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-g games] [-t threads] [-p random|greedy|mcts] [-s seed] [-b WIDTHxHEIGHT] [-r rollouts] [-m ms]\n", name);
+}
+
+
+int main(int argc, char* argv[])
+{
+    static bench_worker_type  workers[MAX_THREADS];
+    const bench_policy_type  *policy = &bench_policies[0];
+    mcts_config_type          mcts_config = { 0 };
+    unsigned int              games = DEFAULT_GAMES;
+    unsigned int              threads = platform_cpu_count();
+    unsigned int              game_threads;
+    unsigned int              first_game = 0;
+    unsigned int              started;
+    unsigned int              i;
+    int                       arg;
+    uint64_t                  seed = 0;
+    size_t                    width = DEFAULT_BOARD_WIDTH;
+    size_t                    height = DEFAULT_BOARD_HEIGHT;
+    char                     *end;
+    uint64_t                  start;
+    uint64_t                  moves = 0;
+    uint64_t                  cascades = 0;
+    uint64_t                  fallbacks = 0;
+    uint64_t                 *move_times = NULL;
+    double                    elapsed;
+    bool                      ok = true;
+
+    for (arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-g") == 0 && arg + 1 < argc) {
+            games = (unsigned int)strtoul(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc) {
+            threads = (unsigned int)strtoul(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc) {
+            seed = strtoull(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "-b") == 0 && arg + 1 < argc) {
+            arg++;
+            width = strtoul(argv[arg], &end, 10);
+            height = *end == 'x' ? strtoul(end + 1, NULL, 10) : 0;
+        } else if (strcmp(argv[arg], "-r") == 0 && arg + 1 < argc) {
+            mcts_config.rollouts = strtoull(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "-m") == 0 && arg + 1 < argc) {
+            mcts_config.time_ms = (uint32_t)strtoul(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "-p") == 0 && arg + 1 < argc) {
+            arg++;
+            for (i = 0; i < sizeof(bench_policies) / sizeof(*bench_policies); i++) {
+                if (strcmp(argv[arg], bench_policies[i].name) == 0) {
+                    policy = &bench_policies[i];
+                    break;
+                }
+            }
+            if (i == sizeof(bench_policies) / sizeof(*bench_policies)) {
+                bench_usage(argv[0]);
+                return 1;
+            }
+        } else {
+            bench_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (threads == 0 || threads > MAX_THREADS || games == 0 ||
+        width == 0 || width > MAX_BOARD_SIZE || height == 0 || height > MAX_BOARD_SIZE || width * height < 2) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+
+    game_threads = policy->parallel ? 1 : threads;
+    if (game_threads > games) {
+        game_threads = games;
+    }
+
+    printf("games: %u  threads: %u  policy: %s  seed: %llu  board: %zux%zu\n",
+           games, threads, policy->name, (unsigned long long)seed, width, height);
+
+    if (policy->parallel) {
+        // A fixed number of trees keeps the moves chosen the same for any
+        // thread count.
+        mcts_config.threads = threads;
+        mcts_config.trees = DEFAULT_MCTS_TREES;
+        mcts_config.seed = seed;
+        if (mcts_config.rollouts == 0 && mcts_config.time_ms == 0) {
+            mcts_config.rollouts = DEFAULT_MCTS_ROLLOUTS;
+        }
+        workers[0].mcts = mcts_create(&mcts_config);
+        if (workers[0].mcts == NULL) {
+            fprintf(stderr, "Failed to set up the search\n");
+            return 1;
+        }
+    }
+
+    start = platform_time_ns();
+    for (i = 0; i < game_threads; i++) {
+        workers[i].policy = policy->fn;
+        workers[i].seed = seed;
+        workers[i].width = width;
+        workers[i].height = height;
+        workers[i].first_game = first_game;
+        workers[i].game_count = games / game_threads + (i < games % game_threads ? 1 : 0);
+        first_game += workers[i].game_count;
+        workers[i].thread = platform_thread_create((platform_thread_fn_type)&bench_worker_main, &workers[i]);
+        if (workers[i].thread == NULL) {
+            fprintf(stderr, "Failed to start worker thread %u\n", i);
+            ok = false;
+            break;
+        }
+    }
+
+    // Wait for every worker that did start, even if the run has failed.
+    started = i;
+    for (i = 0; i < started; i++) {
+        if (platform_thread_join(workers[i].thread) != 0) {
+            ok = false;
+        }
+    }
+    elapsed = (platform_time_ns() - start) / 1e9;
+
+    if (workers[0].mcts != NULL) {
+        mcts_destroy(workers[0].mcts);
+    }
+
+    // Merge the per-move times to find the percentiles.
+    if (ok) {
+        for (i = 0; i < game_threads; i++) {
+            moves += workers[i].moves;
+        }
+        move_times = malloc((moves > 0 ? moves : 1) * sizeof(*move_times));
+        if (move_times == NULL) {
+            fprintf(stderr, "Out of memory merging move times\n");
+            ok = false;
+        }
+    }
+    if (!ok) {
+        for (i = 0; i < game_threads; i++) {
+            free(workers[i].move_times);
+        }
+        return 1;
+    }
+
+    for (i = 0, moves = 0; i < game_threads; i++) {
+        memcpy(&move_times[moves], workers[i].move_times, workers[i].moves * sizeof(*move_times));
+        moves += workers[i].moves;
+        cascades += workers[i].cascades;
+        fallbacks += workers[i].fallbacks;
+        free(workers[i].move_times);
+    }
+    qsort(move_times, moves, sizeof(*move_times), &bench_compare_times);
+
+    printf("elapsed:      %.3f s\n", elapsed);
+    printf("games/sec:    %.1f\n", games / elapsed);
+    printf("moves:        %llu\n", (unsigned long long)moves);
+    printf("moves/sec:    %.1f\n", moves / elapsed);
+    printf("cascades/sec: %.1f\n", cascades / elapsed);
+    if (fallbacks > 0) {
+        printf("fallbacks:    %llu\n", (unsigned long long)fallbacks);
+    }
+    if (moves > 0) {
+        printf("move p50:     %.3f us\n", move_times[moves / 2] / 1e3);
+        printf("move p99:     %.3f us\n", move_times[moves * 99 / 100] / 1e3);
+    }
+
+    free(move_times);
+
+    return 0;
+}
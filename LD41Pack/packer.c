@@ -0,0 +1,284 @@
+/*
+ * Offline asset packer. Decodes the game's media the way the game would and
+ * writes the results into one asset pack (see pack.h), which the game maps at
+ * startup instead of decoding anything.
+ *
+ * Usage: LD41Pack <pack> <list>
+ *
+ * Run it from the Game directory, so the names in the pack are the ones the
+ * game loads, e.g.:
+ *
+ *     LD41Pack media/media.pack media/media.txt
+ *
+ * The list has one file per line. Fonts are listed once for each size the
+ * game uses, as file@height. Blank lines and lines starting with # are
+ * skipped.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_mixer.h>
+#include <SDL2/SDL_ttf.h>
+
+#include "font.h"
+#include "pack.h"
+
+#define MAX_LINE 256
+#define MAX_ENTRIES 256
+
+// Sounds are baked in the format the game opens the mixer with, in main.c.
+// Any that don't match at runtime are decoded from the loose file instead.
+#define PACKER_AUDIO_FREQUENCY MIX_DEFAULT_FREQUENCY
+#define PACKER_AUDIO_FORMAT MIX_DEFAULT_FORMAT
+#define PACKER_AUDIO_CHANNELS 2
+
+/*
+ * Copy a surface's pixels, converted to the pack's pixel format, into a new
+ * buffer after header_size bytes left for the caller. Fills in the entry's
+ * format, size and dimensions.
+ */
+static uint8_t *
+packer_pixels(SDL_Surface     *surface,
+              pack_entry_type *entry,
+              size_t           header_size)
+{
+    SDL_Surface *converted;
+    uint8_t     *data = NULL;
+    int          y;
+
+    converted = SDL_ConvertSurfaceFormat(surface, PACK_PIXEL_FORMAT, 0);
+    if (converted == NULL) {
+        return NULL;
+    }
+
+    entry->format = PACK_PIXEL_FORMAT;
+    entry->width = (uint32_t)converted->w;
+    entry->height = (uint32_t)converted->h;
+    entry->pitch = (uint32_t)converted->w * 4;
+    entry->size = header_size + (uint64_t)entry->pitch * entry->height;
+
+    data = calloc(1, (size_t)entry->size);
+    if (data != NULL) {
+        (void)SDL_LockSurface(converted);
+        for (y = 0; y < converted->h; y++) {
+            memcpy(data + header_size + (size_t)y * entry->pitch,
+                   (const uint8_t *)converted->pixels + (size_t)y * converted->pitch,
+                   entry->pitch);
+        }
+        SDL_UnlockSurface(converted);
+    }
+
+    SDL_FreeSurface(converted);
+
+    return data;
+}
+
+
+static bool
+packer_add_image(pack_entry_type  *entry,
+                 uint8_t         **data,
+                 const char       *filename)
+{
+    SDL_Surface *surface;
+
+    surface = IMG_Load(filename);
+    if (surface == NULL) {
+        fprintf(stderr, "Failed to load %s: %s\n", filename, IMG_GetError());
+        return false;
+    }
+
+    entry->kind = PACK_ENTRY_IMAGE;
+    *data = packer_pixels(surface, entry, 0);
+    SDL_FreeSurface(surface);
+
+    return *data != NULL;
+}
+
+
+static bool
+packer_add_sound(pack_entry_type  *entry,
+                 uint8_t         **data,
+                 const char       *filename)
+{
+    Mix_Chunk *chunk;
+    int        frequency;
+    Uint16     format;
+    int        channels;
+
+    chunk = Mix_LoadWAV(filename);
+    if (chunk == NULL) {
+        fprintf(stderr, "Failed to load %s: %s\n", filename, Mix_GetError());
+        return false;
+    }
+
+    (void)Mix_QuerySpec(&frequency, &format, &channels);
+    entry->kind = PACK_ENTRY_SOUND;
+    entry->format = format;
+    entry->frequency = (uint32_t)frequency;
+    entry->channels = (uint32_t)channels;
+    entry->size = chunk->alen;
+    *data = malloc(chunk->alen > 0 ? chunk->alen : 1);
+    if (*data != NULL) {
+        memcpy(*data, chunk->abuf, chunk->alen);
+    }
+
+    Mix_FreeChunk(chunk);
+
+    return *data != NULL;
+}
+
+
+static bool
+packer_add_font(pack_entry_type  *entry,
+                uint8_t         **data,
+                const char       *filename,
+                int               height)
+{
+    SDL_Surface     *surface;
+    SDL_Rect        *map = NULL;
+    size_t           count = 0;
+    pack_glyph_type *glyphs;
+    size_t           i;
+
+    surface = mapped_font_rasterize(filename, height, &map, &count);
+    if (surface == NULL) {
+        fprintf(stderr, "Failed to rasterize %s at %d: %s\n", filename, height, TTF_GetError());
+        free(map);
+        return false;
+    }
+
+    // The glyphs are 16 bytes each, so the bitmap after them stays aligned.
+    entry->kind = PACK_ENTRY_FONT;
+    entry->count = (uint32_t)count;
+    *data = packer_pixels(surface, entry, count * sizeof(pack_glyph_type));
+    if (*data != NULL) {
+        glyphs = (pack_glyph_type *)*data;
+        for (i = 0; i < count; i++) {
+            glyphs[i].x = map[i].x;
+            glyphs[i].y = map[i].y;
+            glyphs[i].w = map[i].w;
+            glyphs[i].h = map[i].h;
+        }
+    }
+
+    SDL_FreeSurface(surface);
+    free(map);
+
+    return *data != NULL;
+}
+
+
+/*
+ * Decode one line of the list into an entry and its data. Returns false if
+ * it fails.
+ */
+static bool
+packer_add(pack_entry_type  *entry,
+           uint8_t         **data,
+           char             *line)
+{
+    const char *extension;
+    char       *at;
+
+    if (strlen(line) >= PACK_NAME_LENGTH) {
+        fprintf(stderr, "%s: names are limited to %d characters\n", line, PACK_NAME_LENGTH - 1);
+        return false;
+    }
+
+    strcpy(entry->name, line);
+
+    at = strrchr(line, '@');
+    if (at != NULL) {
+        *at = '\0';
+        return packer_add_font(entry, data, line, atoi(at + 1));
+    }
+
+    extension = strrchr(line, '.');
+    if (extension != NULL && (strcmp(extension, ".ogg") == 0 || strcmp(extension, ".wav") == 0)) {
+        return packer_add_sound(entry, data, line);
+    }
+
+    return packer_add_image(entry, data, line);
+}
+
+
+int main(int argc, char* argv[])
+{
+    static pack_entry_type  entries[MAX_ENTRIES];
+    static uint8_t         *data[MAX_ENTRIES];
+    uint32_t                count = 0;
+    uint32_t                i;
+    FILE                   *list;
+    char                    line[MAX_LINE];
+    size_t                  length;
+    bool                    ok = true;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <pack> <list>\n", argv[0]);
+        return 1;
+    }
+
+    list = fopen(argv[2], "r");
+    if (list == NULL) {
+        fprintf(stderr, "Failed to open %s\n", argv[2]);
+        return 1;
+    }
+
+    // Sounds are decoded by the mixer, which needs an audio device, but the
+    // packer has no need to hear them.
+    (void)SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+    (void)SDL_Init(SDL_INIT_AUDIO);
+    (void)IMG_Init(IMG_INIT_PNG);
+    (void)TTF_Init();
+    (void)Mix_Init(MIX_INIT_OGG);
+    if (Mix_OpenAudio(PACKER_AUDIO_FREQUENCY, PACKER_AUDIO_FORMAT, PACKER_AUDIO_CHANNELS, 1024) != 0) {
+        fprintf(stderr, "Failed to open audio: %s\n", Mix_GetError());
+        ok = false;
+    }
+
+    while (ok && fgets(line, sizeof(line), list) != NULL) {
+        length = strcspn(line, "\r\n");
+        line[length] = '\0';
+        if (length == 0 || line[0] == '#') {
+            continue;
+        }
+
+        if (count == MAX_ENTRIES) {
+            fprintf(stderr, "Packs are limited to %d entries\n", MAX_ENTRIES);
+            ok = false;
+            break;
+        }
+
+        ok = packer_add(&entries[count], &data[count], line);
+        count++;
+    }
+
+    fclose(list);
+
+    if (ok) {
+        ok = pack_file_write(argv[1], entries, (const void *const *)data, count);
+        if (ok) {
+            printf("Packed %u entries into %s\n", count, argv[1]);
+        } else {
+            fprintf(stderr, "Failed to write %s\n", argv[1]);
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        free(data[i]);
+    }
+
+    Mix_CloseAudio();
+    Mix_Quit();
+    TTF_Quit();
+    IMG_Quit();
+    SDL_Quit();
+
+    return ok ? 0 : 1;
+}